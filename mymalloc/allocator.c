@@ -20,74 +20,404 @@
  * IN THE SOFTWARE.
  **/
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <immintrin.h>
 #include "./allocator_interface.h"
 #include "./allocator_helper.h"
 #include "./my_checker.h"
 #include "./memlib.h"
+#include "./config.h"
+#include "./size_classes.h"
 
 // Don't call libc malloc!
 #define malloc(...) (USE_MY_MALLOC)
 #define free(...) (USE_MY_FREE)
 #define realloc(...) (USE_MY_REALLOC)
 
-// All blocks must have a specified minimum alignment.
-// The alignment requirement (from config.h) is >= 8 bytes.
-#ifndef ALIGNMENT
-#define ALIGNMENT 8
-#endif
-
 // Rounds up to the nearest multiple of ALIGNMENT.
 #define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1))
 
 #define IS_ALIGNED(ptr) ((((uint64_t) ptr) & (ALIGNMENT-1)) == 0)
 
+#define MIN(a, b) ((b) ^ (((a) ^ (b)) & -((a) < (b))))
+#define MAX(a, b) ((a) ^ (((a) ^ (b)) & -((a) < (b))))
+
+// Rounds a malloc size up to a chunk size. The chunk has to hold the whole aligned size
+// (callers like mdriver fill payloads a word at a time), and the chunk's size plus its size
+// field has to be a multiple of ALIGNMENT so that the next chunk's user pointer is aligned too.
+#define CHUNK_REQUEST(size) MAX(ALIGN(ALIGN(size) + sizeof(size_int)) - sizeof(size_int), SMALLEST_REQUEST)
+
+// The first user pointer at or after ptr that is a multiple of alignment and leaves
+// either no gap or a gap big enough to hold a chunk of its own.
+// The gap has to be at least SMALLEST_REQUEST plus a size field, which can take more than
+// one step of alignment when the alignment is small.
+#define ALIGN_POINTER_UP(ptr, alignment) \
+  ((((ptr) & ((uint64_t) (alignment) - 1)) == 0) ? (ptr) : \
+   (((ptr) + SMALLEST_REQUEST + sizeof(size_int) + (alignment) - 1) & ~((uint64_t) (alignment) - 1)))
+
 // This is a link to all the bins that contain free chunks of memory.
 // They are of the following sizes:
 // 0. (Special) Points to the end of the heap.
-// 1. (Special) A chunk that will be used/split if a malloc can't find space
-// 2. (Special) HUUUUGE CHUNKS (> HUGE_BIN_CUTOFF)
+// 1. (Special) Unused. The chunks malloc splits from are in victims below.
+// 2. 16 bytes (only with COMPRESSED_LINKS)
 // 3. 24 bytes
 // 4. 32 bytes
 // ...
 // 31. 248 bytes
-// 32. 256 - 383 bytes
-// 33. 384 - 511 bytes
-// 34. 512 - 767 bytes
-// ...
-// 62. 8388608 - 12582911 bytes
-// 63. 12582912 - 16777215 bytes
-#define NUM_OF_BINS 64
+// 32. and up: Each doubling from 256 bytes up to 2^47 - 1 bytes is split into 1, 2, 4
+//     or 8 equal ranges, as listed in size_classes.h. That table is generated by
+//     gen_size_classes.py, which gives the busiest doublings of the traces the most bins.
+//     With --uniform 2 it gives the old layout: 256 - 383, 384 - 511, 512 - 767, ...
+#define NUM_OF_BINS (32 + NUM_OF_LARGE_BINS)
 static chunk_t* bins[NUM_OF_BINS];
 
+#define SMALLEST_SMALL_BIN (BIN_KEY(SMALLEST_MALLOC) >> 3)
+
+// Large chunks that were just freed, not yet sorted into their bins. This is kept apart
+// from bins so that bin 2 is free for the 16 byte class of COMPRESSED_LINKS.
+static chunk_t* unsorted_bin;
+#define UNSORTED_BIN unsorted_bin
+
+// The victims are what is left of chunks malloc split, one per size band, used for the
+// next requests of that band before any bin. Keeping a victim per band means requests
+// of one band keep carving from their own region, instead of evicting the remainder
+// another band is carving from. Band 0 takes small requests, each band above it takes
+// VICTIM_BAND_LOG2 doublings of large requests, and the last band everything bigger.
+// With VICTIM_BANDS set to 1 all requests share a single victim.
+#ifndef VICTIM_BANDS
+#define VICTIM_BANDS 3
+#endif
+
+#ifndef VICTIM_BAND_LOG2
+#define VICTIM_BAND_LOG2 4
+#endif
+
+// my_malloc_hint places hinted requests apart from the rest. Each hint class has an arena:
+// a victim after the size bands' victims, so objects of one class sit next to each other
+// and not between objects of another. A free next to an arena gives what it frees back to
+// that arena. An arena is HINT_ARENA_SIZE bytes, or the request if that is bigger, and
+// comes from the bins or, failing that, the end of the heap. With HINT_ARENAS set to 0
+// hinted chunks are malloc'd as usual, and only the slab runs below tell classes apart.
+#ifndef HINT_ARENAS
+#define HINT_ARENAS 1
+#endif
+
+// The hint classes, as bit masks over MALLOC_HINT_CLASS, whose small sizes come from slab
+// runs of their own, and whose chunks come from their arena before the bins. Long-lived
+// objects are packed both ways. Short-lived and cold ones skip slab runs, so a survivor
+// doesn't pin a page of its size class, and take the holes in the bins before growing an
+// arena. On hint_traces this gives 85% utilization against 80% unhinted, and long-lived
+// blocks fill 39% of the pages they touch (30% unhinted), cold ones 81% (68%). Packing
+// every class in slab runs and arenas drops utilization to 65%.
+#ifndef HINT_SLAB_CLASSES
+#define HINT_SLAB_CLASSES (1U << MALLOC_HINT_CLASS(MALLOC_HINT_LONG_LIVED))
+#endif
+
+#ifndef HINT_ARENA_FIRST_CLASSES
+#define HINT_ARENA_FIRST_CLASSES (1U << MALLOC_HINT_CLASS(MALLOC_HINT_LONG_LIVED))
+#endif
+
+#ifndef HINT_ARENA_SIZE
+#define HINT_ARENA_SIZE (8 << 10)
+#endif
+
+// Hinted classes are MALLOC_HINT_CLASS's 1 to HINT_CLASSES; class 0 is unhinted.
+#if HINT_ARENAS
+#define HINT_CLASSES (MALLOC_HINT_CLASSES - 1)
+#else
+#define HINT_CLASSES 0
+#endif
+
+#define NUM_OF_VICTIMS (VICTIM_BANDS + HINT_CLASSES)
+#define HINT_VICTIM(hint) (VICTIM_BANDS + (hint) - 1)
+#define IS_HINT_VICTIM(band) (HINT_CLASSES > 0 && (band) >= VICTIM_BANDS)
+
+static chunk_t* victims[NUM_OF_VICTIMS];
+
+#ifndef EXTENSION_SIZE
+#define EXTENSION_SIZE (SMALLEST_CHUNK + 320)
+#endif
+
+// When the heap grows, it grows by the shortfall plus some slack, so the next requests
+// at the end of the heap don't each need a mem_sbrk. The slack starts at EXTENSION_SIZE
+// and doubles every time the heap has to grow again within HEAP_GROWTH_WINDOW mallocs,
+// up to HEAP_GROWTH_MAX. Once the heap goes longer than that without growing, the slack
+// halves on each growth until it is back at EXTENSION_SIZE. The cap bounds how much of
+// the heap can sit unused at the end, which is what utilization pays for this.
+#ifndef HEAP_GROWTH_MAX
+#define HEAP_GROWTH_MAX 1024
+#endif
+
+#ifndef HEAP_GROWTH_WINDOW
+#define HEAP_GROWTH_WINDOW 8
+#endif
+
+static size_int heap_growth = EXTENSION_SIZE;
+static uint32_t mallocs_since_growth;
+
+// A block realloc grows a second time is probably being built up (a vector, a string),
+// and will keep growing. With REALLOC_HEADROOM set, when it can't grow in place and has
+// to move, it moves into a chunk with 1/2^REALLOC_HEADROOM_SHIFT of the request extra,
+// and the extra is split off behind it as its reserve: a chunk kept in use, so no other
+// malloc carves it and it never joins the end of the heap. The block's next growths
+// take from the reserve, so a block grown n times moves O(log n) times. A reserve is
+// freed with its block, when the block shrinks, and for a malloc that would otherwise
+// grow the heap. At most REALLOC_HEADROOM_SLOTS blocks have one; a new reserve frees
+// the biggest. Off by default: growing two buffers by 64 bytes 20000 times each, with
+// a small malloc between steps, moves them 47 times instead of 80 (and utilization
+// goes from 33% to 43%), but reserves held while the heap grows cost trace_grow_v0
+// 16 points of utilization (89% -> 73%) without saving it a move.
+#ifndef REALLOC_HEADROOM
+#define REALLOC_HEADROOM 0
+#endif
+
+#ifndef REALLOC_HEADROOM_SHIFT
+#define REALLOC_HEADROOM_SHIFT 1
+#endif
+
+#ifndef REALLOC_HEADROOM_SLOTS
+#define REALLOC_HEADROOM_SLOTS 4
+#endif
+
+#if REALLOC_HEADROOM
+// The reserves: in-use chunks right after the blocks they were left behind.
+static chunk_t* headroom[REALLOC_HEADROOM_SLOTS];
+static unsigned int headroom_count;
+#endif
+
+// Realloc moves go through copy_payload. Moves of COPY_STREAM_MIN bytes or more use
+// non-temporal stores that don't pull the destination through the cache (a
+// multi-megabyte move would otherwise evict everything else). From 2 MiB on that is also
+// faster than memmove whether the source is in cache or not. Below that memmove wins as
+// long as the source is in cache (1 MiB: 38 us against 57 us), so smaller moves use it.
+// The streaming kernel is AVX2 if the CPU has it and SSE2 otherwise, picked in my_init.
+// Set COPY_ENGINE to 0 to use memmove for every move instead.
+#ifndef COPY_ENGINE
+#define COPY_ENGINE 1
+#endif
+
+#ifndef COPY_STREAM_MIN
+#define COPY_STREAM_MIN (2 << 20)
+#endif
+
+#if COPY_ENGINE
+#if COPY_STREAM_MIN < 64
+#error "The streaming copy kernels need COPY_STREAM_MIN >= 64"
+#endif
+typedef void (*copy_kernel_t)(char* dst, const char* src, size_t size);
+static copy_kernel_t copy_kernel;
+#endif
+
+// calloc only clears the part of a block that may be dirty. Every heap byte from
+// clean_heap_start up has been inside the last chunk since mem_sbrk handed it out, and
+// the last chunk's payload is never written, so it is still zero. The last chunk only
+// gives memory away from its front, and clean_heap_start follows its highest user
+// pointer. Big callocs from the end of the heap then cost page faults, not a memset.
+// Set CALLOC_KNOWN_ZERO to 0 to clear every calloc'd byte instead.
+#ifndef CALLOC_KNOWN_ZERO
+#define CALLOC_KNOWN_ZERO 1
+#endif
+
+#if CALLOC_KNOWN_ZERO
+static uint64_t clean_heap_start;
+#define RAISE_CLEAN_HEAP_START() \
+  (clean_heap_start = MAX(clean_heap_start, (uint64_t) CHUNK_TO_USER_POINTER(END_OF_HEAP_BIN)))
+#else
+#define RAISE_CLEAN_HEAP_START()
+#endif
+
+#if COMPRESSED_LINKS
+#if MAX_HEAP >= (1LL << 32) - 2*ALIGNMENT
+#error "COMPRESSED_LINKS needs a heap smaller than 4GB"
+#endif
+char* chunk_link_base;
+#endif
+
 typedef unsigned int bin_index;
 
+// One bit per bin, set exactly when that bin holds at least one free chunk.
+// The special bins (0-1) are never marked. This lets the fallback searches in
+// small_malloc and find_best_chunk jump to the next non-empty bin with a
+// count-trailing-zeros per 64 bins instead of probing the bins one by one.
+#define BINMAP_WORDS ((NUM_OF_BINS + 63) / 64)
+static uint64_t binmap[BINMAP_WORDS];
+
+#define MARK_BIN(n) (binmap[(n) >> 6] |= (1ULL << ((n) & 63)))
+#define CLEAR_BIN(n) (binmap[(n) >> 6] &= ~(1ULL << ((n) & 63)))
+#define IS_BIN_MARKED(n) ((binmap[(n) >> 6] >> ((n) & 63)) & 1)
+
+// Fastbins hold freed small chunks of up to FASTBIN_MAX_SIZE bytes, one LIFO list per
+// small bin, linked through their next field. A chunk in a fastbin keeps its
+// CURRENT_INUSE bit, so no boundary tags are touched and nothing coalesces with it
+// until consolidate_fastbins frees them all for real. That happens only when a large
+// request misses or the heap is about to grow.
+#ifndef FASTBINS
+#define FASTBINS 1
+#endif
+
+#ifndef FASTBIN_MAX_SIZE
+#define FASTBIN_MAX_SIZE 128
+#endif
+
+#define IS_FAST_SIZE(size) ((size) <= FASTBIN_MAX_SIZE)
+
+// Set ADDRESS_ORDERED_BINS to 1 to keep every bin in address order instead of LIFO.
+// A small bin then hands out its lowest chunk, and among large chunks of the best fitting
+// size the lowest one is used. Allocations cluster toward the start of the heap, which
+// leaves the end of the heap free for longer. Inserting into a small bin has to walk it.
+#ifndef ADDRESS_ORDERED_BINS
+#define ADDRESS_ORDERED_BINS 0
+#endif
+
+// The tree node of a ring of same-size large chunks isn't always its lowest chunk, but
+// with ADDRESS_ORDERED_BINS the rest of the ring follows it in address order.
+#if ADDRESS_ORDERED_BINS
+#define LOWEST_IN_RING(node_ptr) ((NODE_CHUNK((node_ptr)->next) < NODE_CHUNK(node_ptr)) ? (node_ptr)->next : (node_ptr))
+#else
+#define LOWEST_IN_RING(node_ptr) (node_ptr)
+#endif
+
+#if FASTBINS
+static chunk_t* fastbins[32];
+static uint32_t fastbin_map; // Bit n is set when fastbins[n] is non-empty.
+#endif
+
+// Counters printed by my_print_stats (mdriver -s). They are only collected when
+// building with STATS=1, so the timed runs don't pay for them otherwise.
+#ifdef STATS
+static struct {
+  uint64_t tree_walks;       // Searches and inserts in the large-bin trees
+  uint64_t tree_walk_nodes;  // Tree nodes visited by those walks
+  uint64_t tree_walk_cycles; // Cycles spent in those walks
+  uint64_t slab_mallocs;     // Small requests served from slab runs
+  uint64_t slab_runs;        // Runs carved out of the heap
+  uint64_t slab_runs_released; // Runs given back to the heap once empty
+  uint64_t fastbin_consolidations;
+  uint64_t unsorted_hits;    // Large mallocs served straight from the unsorted bin
+  uint64_t unsorted_sorted;  // Unsorted chunks that had to be sorted into their bins
+  uint64_t realloc_headroom_moves; // Growing reallocs that moved and left headroom behind
+  uint64_t realloc_headroom_reclaimed; // Reserves freed for mallocs that would grow the heap
+  uint64_t calloc_bytes_zeroed;    // Bytes calloc had to clear
+  uint64_t calloc_bytes_clean;     // Bytes calloc knew were zero already
+  uint64_t batch_chunks_carved;    // Chunks malloc_batch carved from a shared chunk
+  uint64_t batch_chunks_merged;    // Chunks free_batch merged into the chunk before them
+  uint64_t region_mallocs;         // Objects bump allocated in regions
+  uint64_t region_blocks;          // Blocks regions took from the heap
+  uint64_t pool_reuses;            // Pool mallocs that took a freed object
+  uint64_t hint_mallocs[MALLOC_HINT_CLASSES]; // Hinted mallocs of each hint class
+  uint64_t hint_arenas[MALLOC_HINT_CLASSES];  // Arenas each hint class took
+} stats;
+
+#define STAT_ADD(field, amount) (stats.field += (amount))
+#define STAT_TIMER(name) uint64_t name = __builtin_ia32_rdtsc()
+#define STAT_ADD_CYCLES(field, name) (stats.field += __builtin_ia32_rdtsc() - (name))
+#else
+#define STAT_ADD(field, amount)
+#define STAT_TIMER(name)
+#define STAT_ADD_CYCLES(field, name)
+#endif
+
+#if LARGE_NODE_TABLE
+// The side table holding the tree nodes of free large chunks. Every free large chunk
+// takes at least LARGE_CHUNK_CUTOFF + 1 bytes of the heap, so this many nodes can
+// never run out. Untouched parts of the table are never paged in.
+#ifndef LARGE_NODE_TABLE_CAPACITY
+#define LARGE_NODE_TABLE_CAPACITY (MAX_HEAP / (LARGE_CHUNK_CUTOFF + 1))
+#endif
+static bigchunk_t node_table[LARGE_NODE_TABLE_CAPACITY] __attribute__((aligned(64)));
+static size_t node_table_top; // Nodes above this have never been used
+static bigchunk_t* free_nodes; // Released nodes, linked through their next field.
+                               // Reusing these first keeps the used part of the table dense.
+
+static bigchunk_t* new_large_node(chunk_t* chunk) {
+  bigchunk_t* node = free_nodes;
+  if (node != NULL) {
+    free_nodes = node->next;
+  } else {
+    assert(node_table_top < LARGE_NODE_TABLE_CAPACITY);
+    node = &node_table[node_table_top++];
+  }
+  node->size = CHUNK_SIZE(chunk);
+  node->chunk = chunk;
+  LARGE_NODE(chunk) = node;
+  return node;
+}
+
+static void free_large_node(bigchunk_t* node) {
+  LARGE_NODE(node->chunk) = NULL;
+  node->chunk = NULL;
+  node->next = free_nodes;
+  free_nodes = node;
+}
+#else
+#define new_large_node(chunk) LARGE_NODE(chunk)
+#define free_large_node(node)
+#endif
+
+#if SLAB_ALLOCATOR
+// Runs with at least one free slot, per small bin. my_malloc takes from the first list,
+// and each hint class in HINT_SLAB_CLASSES from the list of its class number, so hinted
+// objects share pages only with objects of their class.
+#define SLAB_LISTS MALLOC_HINT_CLASSES
+#define HINT_SLAB_LIST(hint) (hint)
+static slab_t* slab_runs[SLAB_LISTS][32];
+
+// How many chunks of each small bin are live. A bin only switches to slab runs once
+// SLAB_MIN_REQUESTS of them are live at the same time, so a trace that allocates and
+// frees a handful of small objects doesn't pay a whole page per size class. The count is
+// shared by every list: the chunks my_malloc and my_malloc_hint counted (marked
+// SLAB_COUNTED) come off it when freed. A count stops at SLAB_MIN_REQUESTS and the bin
+// stays on slab runs from then on.
+#ifndef SLAB_MIN_REQUESTS
+#define SLAB_MIN_REQUESTS 16
+#endif
+static uint32_t slab_class_requests[32];
+
+// One bit per heap page, set when the page holds a slab run. No other chunk can have
+// its user pointer inside such a page, so this is all free and realloc need to tell
+// slab objects apart from chunks.
+#define SLAB_PAGE_MAP_WORDS ((MAX_HEAP >> SLAB_PAGE_LOG2) / 64 + 2)
+static uint64_t slab_pages[SLAB_PAGE_MAP_WORDS];
+static uint64_t heap_first_page;
+
+#define SLAB_PAGE_INDEX(ptr) ((((uint64_t) (ptr)) >> SLAB_PAGE_LOG2) - heap_first_page)
+#define IS_SLAB_POINTER(ptr) ((slab_pages[SLAB_PAGE_INDEX(ptr) >> 6] >> (SLAB_PAGE_INDEX(ptr) & 63)) & 1)
+#define MARK_SLAB_PAGE(ptr) (slab_pages[SLAB_PAGE_INDEX(ptr) >> 6] |= (1ULL << (SLAB_PAGE_INDEX(ptr) & 63)))
+#define CLEAR_SLAB_PAGE(ptr) (slab_pages[SLAB_PAGE_INDEX(ptr) >> 6] &= ~(1ULL << (SLAB_PAGE_INDEX(ptr) & 63)))
+#endif
+
 
 /* ------------------------------------------------------------------------- */
 // [START STATIC METHOD DECLARATIONS]
 // Below this is just all the static methods declared so they can be used anywhere in this file
 
-static int remove_large_chunk(bigchunk_t* chunk);
+static int remove_large_chunk(chunk_t* chunk);
 static int remove_small_chunk(chunk_t* chunk);
 static int remove_chunk(chunk_t* chunk);
-static int insert_large_chunk(bigchunk_t* chunk);
+static int insert_large_chunk(chunk_t* chunk);
 static int insert_small_chunk(chunk_t* chunk);
 static int insert_chunk(chunk_t* chunk);
 static chunk_t* small_malloc(size_int request);
 static chunk_t* large_malloc(size_int request);
 static chunk_t* end_of_heap_malloc(size_int request);
+static chunk_t* victim_malloc(unsigned int band, size_int request);
+static chunk_t* any_victim_malloc(size_int request);
+static void replace_victim(unsigned int band, chunk_t* chunk);
 static chunk_t* combine_chunks(chunk_t* left, chunk_t* right);
 static bigchunk_t* find_replacement_for_large_chunk(bigchunk_t* chunk);
 static int remove_large_single_chunk(bigchunk_t* chunk);
 static int remove_large_linked_list_chunk(bigchunk_t* chunk);
-static chunk_t* huge_malloc(size_int request);
-static int remove_huge_chunk(bigchunk_t* chunk);
-static int insert_huge_chunk(bigchunk_t* chunk);
-static void remove_chunk_or_victim(chunk_t* chunk);
+static bigchunk_t* smallest_chunk_in_subtree(bigchunk_t* root);
+static void update_subtree_min(bigchunk_t* chunk);
+static int remove_chunk_or_victim(chunk_t* chunk);
+static void insert_unsorted_chunk(chunk_t* chunk);
+static void remove_unsorted_chunk(chunk_t* chunk);
+static chunk_t* sort_unsorted_chunks(size_int request);
 static void* default_realloc(void* ptr, size_t size);
 static chunk_t* split_mallocd_chunk(chunk_t* chunk, size_int size);
 static void* realloc_chunk_is_smaller(void* ptr, size_t size);
@@ -95,14 +425,104 @@ static void* realloc_chunk_and_after(void* ptr, size_int request);
 static void* realloc_chunk_and_before(void* ptr, size_int request);
 static void* realloc_chunk_before_and_after(void* ptr, size_int request);
 static void* realloc_chunk_after_extend_heap(void* ptr, size_int request);
-static void* realloc_chunk_is_larger(void* ptr, size_int request);
+static void* realloc_chunk_is_larger(void* ptr, size_t size);
+#if REALLOC_HEADROOM
+static void* realloc_with_headroom(void* ptr, size_t size);
+static void* realloc_into_headroom(void* ptr, size_int request);
+static int headroom_slot(chunk_t* chunk);
+static void reserve_headroom(chunk_t* chunk);
+static void release_headroom(int slot);
+static chunk_t* headroom_malloc(size_int request);
+#endif
+static void* mark_realloc_grown(void* ptr);
+static inline void copy_payload(void* dst, const void* src, size_t size);
+#if COPY_ENGINE
+static void copy_sse2(char* dst, const char* src, size_t size);
+static void copy_avx2(char* dst, const char* src, size_t size) __attribute__((target("avx2")));
+#endif
 static void resize_chunk_and_split(chunk_t* base, size_int new_size, size_int request);
+static chunk_t* bin_malloc(size_int request);
+static chunk_t* malloc_chunk(size_int request);
+static chunk_t* aligned_malloc_chunk(size_int alignment, size_int request);
+static chunk_t* find_aligned_chunk(size_int alignment, size_int request);
+static bigchunk_t* smallest_aligned_fit_in_tree(bigchunk_t* root, size_int alignment, size_int request);
+static chunk_t* aligned_end_of_heap_malloc(size_int alignment, size_int request);
+static size_int next_heap_growth();
+static size_int grow_heap(size_int difference);
+static bool extend_end_of_heap(size_int request);
+static void free_chunk(chunk_t* chunk);
+#if HINT_ARENAS
+static chunk_t* hint_arena_malloc(unsigned int hint, size_int request);
+#endif
+static chunk_t* carve_batch(chunk_t* chunk, size_int request, size_t count, void** out);
+static void region_init(region_t* region);
+static void* region_malloc_block(region_t* region, size_t request);
+static void region_free_blocks(region_t* region, struct region_block* keep);
+#if FASTBINS
+static void consolidate_fastbins();
+#endif
+#if SLAB_ALLOCATOR
+static slab_t* new_slab_run(unsigned int list, bin_index i);
+static void link_slab_run(slab_t* run);
+static void release_slab_run(slab_t* run);
+static bool is_busy_slab_class(size_int object_size);
+static void count_small_chunk(chunk_t* chunk, size_int object_size);
+static void forget_small_chunk(chunk_t* chunk);
+static void* slab_malloc(unsigned int list, size_int request);
+static void slab_free(void* ptr);
+static void* slab_realloc(void* ptr, size_t size);
+#endif
 
 // [END STATIC METHOD DECLARATIONS]
 /* ------------------------------------------------------------------------- */
 
 int my_check() {
-  return my_checker(bins, NUM_OF_BINS);
+  for (bin_index n = SMALLEST_SMALL_BIN; n < NUM_OF_BINS; n++)
+    assert((bins[n] != NULL) == IS_BIN_MARKED(n));
+  if (UNSORTED_BIN != NULL) {
+    assert(is_circularly_linked_list(UNSORTED_BIN));
+    chunk_t* chunk = UNSORTED_BIN;
+    do {
+      assert(IS_UNSORTED(chunk) && IS_CURRENT_FREE(chunk) && IS_LARGE_CHUNK(chunk));
+      chunk = NEXT_FREE_CHUNK(chunk);
+    } while (chunk != UNSORTED_BIN);
+  }
+  #if FASTBINS
+  for (bin_index n = SMALLEST_SMALL_BIN; n < 32; n++) {
+    assert((fastbins[n] != NULL) == ((fastbin_map >> n) & 1));
+    for (chunk_t* chunk = fastbins[n]; chunk != NULL; chunk = NEXT_FREE_CHUNK(chunk)) {
+      assert(IS_CURRENT_INUSE(chunk));
+      assert(BIN_KEY(CHUNK_SIZE(chunk)) >> 3 == n);
+      assert(!IS_END_OF_HEAP(chunk));
+    }
+  }
+  #endif
+  #if SLAB_ALLOCATOR
+  for (unsigned int list = 0; list < SLAB_LISTS; list++) {
+    for (bin_index n = SMALLEST_SMALL_BIN; n < 32; n++) {
+      for (slab_t* run = slab_runs[list][n]; run != NULL; run = run->next) {
+        assert(IS_SLAB_POINTER(run) && run->list == list);
+        assert(run->next == NULL || run->next->prev == run);
+        assert(is_valid_slab_run(run, n));
+      }
+    }
+  }
+  #endif
+  #if ADDRESS_ORDERED_BINS
+  for (bin_index n = SMALLEST_SMALL_BIN; n < 32; n++) {
+    if (bins[n] == NULL)
+      continue;
+    for (chunk_t* chunk = bins[n]; NEXT_FREE_CHUNK(chunk) != bins[n]; chunk = NEXT_FREE_CHUNK(chunk))
+      assert(chunk < NEXT_FREE_CHUNK(chunk));
+  }
+  #endif
+  for (int b = 0; b < NUM_OF_VICTIMS; b++) {
+    if (victims[b] != NULL) {
+      assert(IS_CURRENT_FREE(victims[b]) && !IS_UNSORTED(victims[b]));
+      assert(!IS_END_OF_HEAP(victims[b]));
+    }
+  }
+  return my_checker(bins, NUM_OF_BINS, victims, NUM_OF_VICTIMS);
 }
 
 // init - Initialize the malloc package.  Called once before any other
@@ -116,16 +536,50 @@ int my_check() {
 #endif
 
 int my_init() {
+  memset(bins, 0, sizeof(bins));
+  memset(binmap, 0, sizeof(binmap));
+  UNSORTED_BIN = NULL;
+  memset(victims, 0, sizeof(victims));
+  heap_growth = EXTENSION_SIZE;
+  mallocs_since_growth = 0;
+  #if COMPRESSED_LINKS
+  chunk_link_base = (char*) mem_heap_lo() - ALIGNMENT;
+  #endif
+  #if COPY_ENGINE
+  __builtin_cpu_init();
+  copy_kernel = __builtin_cpu_supports("avx2") ? copy_avx2 : copy_sse2;
+  #endif
+  #if LARGE_NODE_TABLE
+  node_table_top = 0;
+  free_nodes = NULL;
+  #endif
+  #ifdef STATS
+  memset(&stats, 0, sizeof(stats));
+  #endif
+  #if FASTBINS
+  memset(fastbins, 0, sizeof(fastbins));
+  fastbin_map = 0;
+  #endif
+  #if SLAB_ALLOCATOR
+  memset(slab_runs, 0, sizeof(slab_runs));
+  memset(slab_class_requests, 0, sizeof(slab_class_requests));
+  memset(slab_pages, 0, sizeof(slab_pages));
+  heap_first_page = ((uint64_t) mem_heap_lo()) >> SLAB_PAGE_LOG2;
+  #endif
   void *brk = mem_heap_hi() + 1;
-  int req_size = ALIGN((uint64_t)brk) - (uint64_t)brk;
+  int req_size = (uint64_t) FIRST_HEAP_CHUNK(brk) - (uint64_t) brk;
   if (req_size != 0)
     mem_sbrk(req_size);
-  assert(IS_ALIGNED(mem_heap_hi() + 1));
-  chunk_t* first_chunk = mem_sbrk(INITIAL_CHUNK_SIZE + 2*sizeof(size_int));
-  assert(IS_ALIGNED(first_chunk));
-  first_chunk->current_size = INITIAL_CHUNK_SIZE;
+  chunk_t* first_chunk = mem_sbrk(CHUNK_REQUEST(INITIAL_CHUNK_SIZE) + 2*sizeof(size_int));
+  assert(first_chunk == FIRST_HEAP_CHUNK(mem_heap_lo()));
+  assert(IS_ALIGNED(CHUNK_TO_USER_POINTER(first_chunk)));
+  first_chunk->current_size = CHUNK_REQUEST(INITIAL_CHUNK_SIZE);
   SET_PREVIOUS_INUSE(first_chunk);
   END_OF_HEAP_BIN = first_chunk;
+  #if CALLOC_KNOWN_ZERO
+  // Heaps from before the last reset may have written anywhere below mem_clean_lo.
+  clean_heap_start = MAX((uint64_t) CHUNK_TO_USER_POINTER(first_chunk), (uint64_t) mem_clean_lo());
+  #endif
   assert(IS_END_OF_HEAP(first_chunk));
   assert(IS_END_OF_HEAP(END_OF_HEAP_BIN));
   #ifdef DEBUG
@@ -139,29 +593,105 @@ int my_init() {
 
 static inline bin_index small_request_index(size_int request) {
   assert(IS_SMALL_SIZE(request));
-  bin_index result = request >> 3;
-  assert(result > 2 && result < 33);
+  bin_index result = BIN_KEY(request) >> 3;
+  assert(result >= SMALLEST_SMALL_BIN && result < 32);
   return result;
 }
 
 
 static inline bin_index large_request_index(size_int request) {
   assert(IS_LARGE_SIZE(request));
-  int l = FAST_LOG2(request);
-  bin_index result = 16 + 2*l + ((request >> (l-1)) & 1);
-  assert(result > 31 && result < 64);
+  size_int key = BIN_KEY(request);
+  int l = FAST_LOG2(key);
+  bin_index result = large_bin_table[((l - FIRST_LARGE_LOG2) << SIZE_CLASS_BITS) |
+                                     ((key >> (l - SIZE_CLASS_BITS)) & ((1 << SIZE_CLASS_BITS) - 1))];
+  assert(result > 31 && result < NUM_OF_BINS);
   return result;
 }
+
+static inline unsigned int victim_band(size_int request) {
+  if (VICTIM_BANDS == 1 || IS_SMALL_SIZE(request))
+    return 0;
+  unsigned int band = 1 + (FAST_LOG2(BIN_KEY(request)) - FIRST_LARGE_LOG2) / VICTIM_BAND_LOG2;
+  return (band < VICTIM_BANDS) ? band : VICTIM_BANDS - 1;
+}
+
+// Returns the band chunk is the victim of, or -1 if it isn't a victim.
+static inline int victim_index(chunk_t* chunk) {
+  for (int b = 0; b < NUM_OF_VICTIMS; b++)
+    if (victims[b] == chunk)
+      return b;
+  return -1;
+}
+
+#define IS_VICTIM(chunk_ptr) (victim_index(chunk_ptr) >= 0)
+
+// Returns the first non-empty bin at or after n, or NUM_OF_BINS if every
+// bin from n onwards is empty.
+static inline bin_index next_nonempty_bin(bin_index n) {
+  if (n >= NUM_OF_BINS)
+    return NUM_OF_BINS;
+  unsigned int word = n >> 6;
+  uint64_t candidates = binmap[word] & (~0ULL << (n & 63));
+  while (candidates == 0) {
+    if (++word == BINMAP_WORDS)
+      return NUM_OF_BINS;
+    candidates = binmap[word];
+  }
+  return (word << 6) + __builtin_ctzll(candidates);
+}
 // [END INDEXING METHODS]
 /* ------------------------------------------------------------------------- */
 
 /* ------------------------------------------------------------------------- */
 
+static inline size_int compute_subtree_min(bigchunk_t* chunk) {
+  size_int min = NODE_SIZE(chunk);
+  if (SUBTREE_MIN(chunk->children[0]) < min)
+    min = SUBTREE_MIN(chunk->children[0]);
+  if (SUBTREE_MIN(chunk->children[1]) < min)
+    min = SUBTREE_MIN(chunk->children[1]);
+  return min;
+}
+
+// Recomputes the subtree minimum of a tree node whose children just changed, then
+// propagates it up towards the root. Ancestors were correct before the change, so
+// we can stop as soon as one of them doesn't change.
+static void update_subtree_min(bigchunk_t* chunk) {
+  assert(chunk != NULL && chunk != NO_PARENT_ROOT_NODE);
+  chunk->subtree_min = compute_subtree_min(chunk);
+  bigchunk_t* current = chunk->parent;
+  while (current != NO_PARENT_ROOT_NODE) {
+    assert(current != NULL);
+    size_int min = compute_subtree_min(current);
+    if (current->subtree_min == min)
+      break;
+    current->subtree_min = min;
+    current = current->parent;
+  }
+}
+
+// Finds a chunk whose size is the subtree minimum by following the child
+// that holds the minimum. Takes O(depth).
+static bigchunk_t* smallest_chunk_in_subtree(bigchunk_t* root) {
+  assert(root != NULL);
+  size_int min = root->subtree_min;
+  bigchunk_t* current = root;
+  while (NODE_SIZE(current) != min) {
+    current = (SUBTREE_MIN(current->children[0]) == min) ? current->children[0] : current->children[1];
+    assert(current != NULL && current->subtree_min == min);
+  }
+  return current;
+}
+
+// Replaces chunk with new_child (possibly NULL) in the tree, and fixes up the
+// subtree minimums along the path to the root.
 static inline void link_chunk_with_parent(bigchunk_t* chunk, bigchunk_t* new_child) {
   assert(chunk->parent != new_child);
   assert(chunk->parent != NULL);
+  bigchunk_t* parent = chunk->parent;
   if (chunk->parent == NO_PARENT_ROOT_NODE) {
-    bin_index n = large_request_index(CHUNK_SIZE(chunk));
+    bin_index n = large_request_index(NODE_SIZE(chunk));
     bins[n] = (chunk_t*) new_child;
   } else {
     if (chunk->parent->children[0] == chunk)
@@ -177,6 +707,10 @@ static inline void link_chunk_with_parent(bigchunk_t* chunk, bigchunk_t* new_chi
   if (new_child != NULL)
     new_child->parent = chunk->parent;
   chunk->parent = NULL;
+  if (new_child != NULL)
+    update_subtree_min(new_child);
+  else if (parent != NO_PARENT_ROOT_NODE)
+    update_subtree_min(parent);
 }
 
 // Safely makes the replacement's children equal to chunk's children, also replacing
@@ -191,7 +725,7 @@ static inline void link_children_with_parent(bigchunk_t* chunk, bigchunk_t* repl
 }
 
 static bigchunk_t* find_replacement_for_large_chunk(bigchunk_t* chunk) {
-  assert(IS_LARGE_CHUNK(chunk) && !IS_HUGE_CHUNK(chunk));
+  assert(IS_LARGE_SIZE(NODE_SIZE(chunk)));
   // First, go down the left side
   bigchunk_t* current = chunk->children[0];
   // "If it has at least one child, go to that child"
@@ -214,7 +748,7 @@ static bigchunk_t* find_replacement_for_large_chunk(bigchunk_t* chunk) {
 }
 
 static int remove_large_single_chunk(bigchunk_t* chunk) {
-  assert(IS_LARGE_CHUNK(chunk) && !IS_HUGE_CHUNK(chunk));
+  assert(IS_LARGE_SIZE(NODE_SIZE(chunk)));
   bigchunk_t* replacement = find_replacement_for_large_chunk(chunk);
   // A null replacement means that none was found
   if (replacement == NULL) {
@@ -241,7 +775,7 @@ static int remove_large_single_chunk(bigchunk_t* chunk) {
 }
 
 static int remove_large_linked_list_chunk(bigchunk_t* chunk) {
-  assert(IS_LARGE_CHUNK(chunk) && !IS_HUGE_CHUNK(chunk));
+  assert(IS_LARGE_SIZE(NODE_SIZE(chunk)));
   assert(!CIRCULAR_LIST_IS_LENGTH_ONE(chunk));
   bigchunk_t* replacement = chunk->next;
   replacement->prev = chunk->prev;
@@ -259,19 +793,6 @@ static int remove_large_linked_list_chunk(bigchunk_t* chunk) {
 // Below lies the methods to insert and remove chunks from their respective bins
 // There are different methods for large and small chunks
 
-static int remove_huge_chunk(bigchunk_t* chunk) {
-  if (CIRCULAR_LIST_IS_LENGTH_ONE(chunk)) {
-    HUGE_BIN = NULL;
-    return 1;
-  }
-  if (HUGE_BIN == (chunk_t*) chunk)
-    HUGE_BIN = (chunk_t*) chunk->next;
-  chunk->next->prev = chunk->prev;
-  chunk->prev->next = chunk->next;
-  chunk->next = chunk->prev = NULL;
-  return 0;
-}
-
 // Pseudocode - If this chunk is in a circularly linked list of length > 1
 // unlink the node from the linked list and if this node has a parent, set the
 // parent of the next node to the parent of this node.
@@ -284,19 +805,18 @@ static int remove_huge_chunk(bigchunk_t* chunk) {
 // Finally, if the parent isn't NO_PARENT_ROOT_NODE, set the corresponding
 // left or right child to the new child node. Return 0. If the parent is NO_PARENT_ROOT_NODE,
 // then point the bucket to the right spot. Return 1.
-static int remove_large_chunk(bigchunk_t* chunk) {
-  assert(IS_LARGE_CHUNK(chunk));
-  if (IS_HUGE_CHUNK(chunk)) {
-    return remove_huge_chunk(chunk);
-  }
-  #ifdef DEBUG
-  size_int size = CHUNK_SIZE(chunk);
-  bin_index n = large_request_index(size);
-  #endif
+static int remove_large_chunk(chunk_t* free_chunk) {
+  assert(IS_LARGE_CHUNK(free_chunk));
+  bigchunk_t* chunk = LARGE_NODE(free_chunk);
+  assert(NODE_CHUNK(chunk) == free_chunk);
+  bin_index n = chunk->bin_number;
+  assert(n == large_request_index(NODE_SIZE(chunk)));
   assert(is_valid_pointer_tree(n, (bigchunk_t*) bins[n]));
   if (CIRCULAR_LIST_IS_LENGTH_ONE(chunk)) {
     assert(chunk->parent != NULL);
     remove_large_single_chunk(chunk);
+    if (bins[n] == NULL)
+      CLEAR_BIN(n);
   } else {
     remove_large_linked_list_chunk(chunk);
   }
@@ -306,8 +826,10 @@ static int remove_large_chunk(bigchunk_t* chunk) {
   chunk->parent = NULL;
   chunk->children[0] = NULL;
   chunk->children[1] = NULL;
+  chunk->subtree_min = 0;
   chunk->bin_number = 0;
   chunk->shift = 0;
+  free_large_node(chunk);
   assert(is_valid_pointer_tree(n, (bigchunk_t*) bins[n]));
   return 0;
 }
@@ -319,52 +841,98 @@ static int remove_large_chunk(bigchunk_t* chunk) {
 static int remove_small_chunk(chunk_t* chunk) {
   assert(IS_SMALL_CHUNK(chunk));
   bin_index n = small_request_index(CHUNK_SIZE(chunk));
-  if (CIRCULAR_LIST_IS_LENGTH_ONE(chunk)) {
+  if (FREE_LIST_IS_LENGTH_ONE(chunk)) {
     bins[n] = NULL;
+    CLEAR_BIN(n);
     return 1;
   }
+  chunk_t* next = NEXT_FREE_CHUNK(chunk);
+  chunk_t* prev = PREV_FREE_CHUNK(chunk);
   if (bins[n] == chunk)
-    bins[n] = chunk->next;
-  chunk->next->prev = chunk->prev;
-  chunk->prev->next = chunk->next;
-  chunk->next = chunk->prev = NULL;
+    bins[n] = next;
+  SET_PREV_FREE_CHUNK(next, prev);
+  SET_NEXT_FREE_CHUNK(prev, next);
+  SET_NEXT_FREE_CHUNK(chunk, NULL);
+  SET_PREV_FREE_CHUNK(chunk, NULL);
   assert(is_circularly_linked_list(bins[n]));
   return 0;
 }
 
 static int remove_chunk(chunk_t* chunk) {
   if (IS_LARGE_CHUNK(chunk))
-    return remove_large_chunk((bigchunk_t*) chunk);
+    return remove_large_chunk(chunk);
   else
     return remove_small_chunk(chunk);
 }
 
-static int insert_huge_chunk(bigchunk_t* chunk) {
-  int result = 0;
-  if (HUGE_BIN == NULL) {
-    chunk->next = chunk;
-    chunk->prev = chunk;
-    result = 1;
+// Returns the band chunk was the victim of, or -1 if it was in a bin.
+static int remove_chunk_or_victim(chunk_t* chunk) {
+  int band = victim_index(chunk);
+  if (band >= 0)
+    victims[band] = NULL;
+  else if (IS_UNSORTED(chunk))
+    remove_unsorted_chunk(chunk);
+  else
+    remove_chunk(chunk);
+  return band;
+}
+
+// The unsorted bin is a circular list like a small bin. Its chunks carry the
+// UNSORTED_CHUNK bit, so a neighbour being coalesced can tell which list it is on.
+static void insert_unsorted_chunk(chunk_t* chunk) {
+  assert(IS_LARGE_CHUNK(chunk) && IS_CURRENT_FREE(chunk));
+  chunk->current_size |= UNSORTED_CHUNK;
+  if (UNSORTED_BIN == NULL) {
+    SET_NEXT_FREE_CHUNK(chunk, chunk);
+    SET_PREV_FREE_CHUNK(chunk, chunk);
   } else {
-    chunk->next = (bigchunk_t*) HUGE_BIN;
-    chunk->prev = (bigchunk_t*) HUGE_BIN->prev;
-    chunk->prev->next = chunk;
-    chunk->next->prev = chunk;
+    chunk_t* prev = PREV_FREE_CHUNK(UNSORTED_BIN);
+    SET_NEXT_FREE_CHUNK(chunk, UNSORTED_BIN);
+    SET_PREV_FREE_CHUNK(chunk, prev);
+    SET_NEXT_FREE_CHUNK(prev, chunk);
+    SET_PREV_FREE_CHUNK(UNSORTED_BIN, chunk);
   }
-  HUGE_BIN = (chunk_t*) chunk;
-  return result;
+  UNSORTED_BIN = chunk;
 }
 
-static void remove_chunk_or_victim(chunk_t* chunk) {
-  if (chunk == VICTIM_BIN)
-    VICTIM_BIN = NULL;
-  else
-    remove_chunk(chunk);
+static void remove_unsorted_chunk(chunk_t* chunk) {
+  assert(IS_UNSORTED(chunk));
+  chunk->current_size &= ~UNSORTED_CHUNK;
+  if (FREE_LIST_IS_LENGTH_ONE(chunk)) {
+    UNSORTED_BIN = NULL;
+  } else {
+    chunk_t* next = NEXT_FREE_CHUNK(chunk);
+    chunk_t* prev = PREV_FREE_CHUNK(chunk);
+    if (UNSORTED_BIN == chunk)
+      UNSORTED_BIN = next;
+    SET_PREV_FREE_CHUNK(next, prev);
+    SET_NEXT_FREE_CHUNK(prev, next);
+  }
+  SET_NEXT_FREE_CHUNK(chunk, NULL);
+  SET_PREV_FREE_CHUNK(chunk, NULL);
+}
+
+// Pseudocode - Take chunks off the unsorted bin, most recently freed first. If one is
+// close enough to the request that it couldn't be split anyway, return it and leave the
+// rest where they are. Otherwise sort it into its bin. A request of 0 sorts everything.
+static chunk_t* sort_unsorted_chunks(size_int request) {
+  while (UNSORTED_BIN != NULL) {
+    chunk_t* chunk = UNSORTED_BIN;
+    remove_unsorted_chunk(chunk);
+    size_int size = CHUNK_SIZE(chunk);
+    if (request != 0 && size >= request && size < request + SMALLEST_CHUNK) {
+      STAT_ADD(unsorted_hits, 1);
+      return chunk;
+    }
+    STAT_ADD(unsorted_sorted, 1);
+    insert_large_chunk(chunk);
+  }
+  return NULL;
 }
 
 // Pseudocode - First, calculate the bin this node should go in. Set the bin
 // field of this chunk to that. If that bin is empty:
-// Calculate the fast log of the size, and subtract two. This is the "shift" field
+// Look up the root shift of that bin in large_bin_shift. This is the "shift" field
 // Set the parent to NO_PARENT_ROOT_NODE and set the bin to point to this node. Return 2.
 // If that bin has elements: Traverse down the tree by going to the child that
 // corresponds to (chunk_size >> shift) & 1. Stop when one of these things happens:
@@ -376,28 +944,39 @@ static void remove_chunk_or_victim(chunk_t* chunk) {
 // right pointers of the linked list to yourself. Return 1.
 // As you're traversing down the list, the "shift" field should be 1 less than it's parent.
 
-static int insert_large_chunk(bigchunk_t* chunk) {
-  assert(IS_LARGE_CHUNK(chunk));
-  if (IS_HUGE_CHUNK(chunk)) {
-    return insert_huge_chunk(chunk);
-  }
+static int insert_large_chunk(chunk_t* free_chunk) {
+  assert(IS_LARGE_CHUNK(free_chunk));
+  STAT_TIMER(start);
+  bigchunk_t* chunk = new_large_node(free_chunk);
   chunk->next = chunk->prev = chunk->parent = chunk->children[0] = chunk->children[1] = NULL;
+  chunk->subtree_min = NODE_SIZE(chunk);
   chunk->bin_number = chunk->shift = 0;
   // Clear out old (potentially unsafe) values.
-  bin_index n = large_request_index(CHUNK_SIZE(chunk));
+  bin_index n = large_request_index(NODE_SIZE(chunk));
   assert(is_valid_pointer_tree(n, (bigchunk_t*) bins[n]));
   chunk->bin_number = n;
   bigchunk_t* parent = NO_PARENT_ROOT_NODE;
   bigchunk_t* current = (bigchunk_t*) bins[n];
-  size_int size = CHUNK_SIZE(chunk);
+  size_int size = NODE_SIZE(chunk);
+  size_int key = BIN_KEY(size);
   while (current != NULL) {
-    if (CHUNK_SIZES_EQUAL(current, chunk)) {
+    STAT_ADD(tree_walk_nodes, 1);
+    if (NODE_SIZE(current) == size) {
+      STAT_ADD(tree_walks, 1);
+      STAT_ADD_CYCLES(tree_walk_cycles, start);
       chunk->parent = NO_PARENT_CIRCLE_NODE;
       chunk->shift = current->shift;
-      chunk->next = current;
-      chunk->prev = current->prev;
-      current->prev->next = chunk;
-      current->prev = chunk;
+      bigchunk_t* position = current;
+      #if ADDRESS_ORDERED_BINS
+      // Keep the rest of the ring in address order after the tree node.
+      position = current->next;
+      while (position != current && NODE_CHUNK(position) < free_chunk)
+        position = position->next;
+      #endif
+      chunk->next = position;
+      chunk->prev = position->prev;
+      position->prev->next = chunk;
+      position->prev = chunk;
       assert(current->bin_number == chunk->bin_number);
       assert(chunk->bin_number == n);
       assert(!CONTAINS_TREE_LOOPS(chunk));
@@ -407,20 +986,24 @@ static int insert_large_chunk(bigchunk_t* chunk) {
       return 0;
     }
     parent = current;
-    current = current->children[(size >> current->shift) & 1];
+    current = current->children[(key >> current->shift) & 1];
   }
   assert(current == NULL);
   assert(parent != NULL);
+  STAT_ADD(tree_walks, 1);
+  STAT_ADD_CYCLES(tree_walk_cycles, start);
   chunk->parent = parent;
   int result = 0;
   if (parent == NO_PARENT_ROOT_NODE) {
     // This means it skipped the while loop.
-    chunk->shift = FAST_LOG2(CHUNK_SIZE(chunk)) - 2;
+    chunk->shift = large_bin_shift[n - 32];
     bins[n] = (chunk_t*) chunk;
+    MARK_BIN(n);
     result = 2;
   } else {
-    parent->children[(size >> parent->shift) & 1] = chunk;
+    parent->children[(key >> parent->shift) & 1] = chunk;
     chunk->shift = parent->shift - 1;
+    update_subtree_min(chunk);
     result = 1;
   }
   chunk->next = chunk;
@@ -442,16 +1025,28 @@ static int insert_small_chunk(chunk_t* chunk) {
   int result = 0;
   bin_index n = small_request_index(CHUNK_SIZE(chunk));
   if (bins[n] == NULL) {
-    chunk->next = chunk;
-    chunk->prev = chunk;
+    SET_NEXT_FREE_CHUNK(chunk, chunk);
+    SET_PREV_FREE_CHUNK(chunk, chunk);
+    MARK_BIN(n);
     result = 1;
   } else {
-    chunk->next = bins[n];
-    chunk->prev = bins[n]->prev;
-    chunk->prev->next = chunk;
-    chunk->next->prev = chunk;
+    chunk_t* position = bins[n];
+    #if ADDRESS_ORDERED_BINS
+    // Insert before the first chunk at a higher address. The bin points at the lowest one.
+    while (position < chunk) {
+      position = NEXT_FREE_CHUNK(position);
+      if (position == bins[n])
+        break;
+    }
+    #endif
+    chunk_t* prev = PREV_FREE_CHUNK(position);
+    SET_NEXT_FREE_CHUNK(chunk, position);
+    SET_PREV_FREE_CHUNK(chunk, prev);
+    SET_NEXT_FREE_CHUNK(prev, chunk);
+    SET_PREV_FREE_CHUNK(position, chunk);
   }
-  bins[n] = chunk;
+  if (result == 1 || !ADDRESS_ORDERED_BINS || chunk < bins[n])
+    bins[n] = chunk;
   assert(is_circularly_linked_list(chunk));
   return result;
 }
@@ -459,8 +1054,8 @@ static int insert_small_chunk(chunk_t* chunk) {
 static int insert_chunk(chunk_t* chunk) {
   int result;
   if (IS_LARGE_CHUNK(chunk)) {
-    result = insert_large_chunk((bigchunk_t*) chunk);
-    assert(IS_VALID_LARGE_CHUNK((bigchunk_t*) chunk));
+    result = insert_large_chunk(chunk);
+    assert(IS_VALID_LARGE_CHUNK(LARGE_NODE(chunk)));
   } else {
     result = insert_small_chunk(chunk);
     assert(IS_VALID_SMALL_CHUNK(chunk));
@@ -489,159 +1084,177 @@ static chunk_t* split_chunk(chunk_t* chunk, size_int request) {
   chunk_t* next_chunk = NEXT_HEAP_CHUNK(chunk);
   next_chunk->previous_size = request;
   next_chunk->current_size = leftover;
-  if (!IS_END_OF_HEAP(next_chunk))
+  // The rest of the last chunk is the new last chunk, which has nothing after it.
+  if (!IS_END_OF_HEAP(chunk))
     NEXT_HEAP_CHUNK(next_chunk)->previous_size = leftover;
   return next_chunk;
 }
 
+// Set BIDIRECTIONAL_SPLITS to 1 to have large requests take the tail of the chunk they
+// are split from, while small ones keep taking the head. The two populations then grow
+// toward each other from opposite ends of free space instead of interleaving, so
+// short-lived small objects don't end up between long-lived large ones. On the traces it
+// loses more than it gains (trace_c6 most of all), so by default every split hands out
+// the front of the chunk.
+#ifndef BIDIRECTIONAL_SPLITS
+#define BIDIRECTIONAL_SPLITS 0
+#endif
+
+#if BIDIRECTIONAL_SPLITS || HINT_ARENAS
+// Splits a chunk in two pieces, and returns the address of the second chunk, which is
+// request bytes. The first chunk stays where it is, free, with the leftover.
+static chunk_t* split_chunk_tail(chunk_t* chunk, size_int request) {
+  assert(CAN_SPLIT_CHUNK(chunk, request));
+  assert(IS_CURRENT_FREE(chunk) && !IS_END_OF_HEAP(chunk));
+  size_int leftover = CHUNK_SIZE(chunk) - request - sizeof(size_int);
+  chunk->current_size = leftover | IS_PREVIOUS_INUSE(chunk);
+  chunk_t* tail = NEXT_HEAP_CHUNK(chunk);
+  tail->previous_size = leftover;
+  tail->current_size = request;
+  return tail;
+}
+#endif
+
+// Splits request bytes off a free chunk for a malloc, returns them, and puts what is left
+// in *rest. See BIDIRECTIONAL_SPLITS for which end the request comes from.
+static chunk_t* carve_chunk(chunk_t* chunk, size_int request, chunk_t** rest) {
+  #if BIDIRECTIONAL_SPLITS
+  if (IS_LARGE_SIZE(request)) {
+    *rest = chunk;
+    return split_chunk_tail(chunk, request);
+  }
+  #endif
+  *rest = split_chunk(chunk, request);
+  return chunk;
+}
+
+// Carves the request out of the given band's victim, or takes the whole victim if the
+// rest would be too small to be a chunk. Returns NULL if the victim isn't large enough.
+static chunk_t* victim_malloc(unsigned int band, size_int request) {
+  chunk_t* result = victims[band];
+  if (result == NULL || CHUNK_SIZE(result) < request)
+    return NULL;
+  if (!CAN_SPLIT_CHUNK(result, request)) {
+    victims[band] = NULL;
+    return result;
+  }
+  return carve_chunk(result, request, &victims[band]);
+}
+
+// Once no bin has room for a request, the only free memory left outside the end of the
+// heap may be the victims of other bands. Take it from the smallest one that fits.
+static chunk_t* any_victim_malloc(size_int request) {
+  int best = -1;
+  for (int b = 0; b < NUM_OF_VICTIMS; b++) {
+    if (victims[b] != NULL && CHUNK_SIZE(victims[b]) >= request &&
+        (best < 0 || CHUNK_SIZE(victims[b]) < CHUNK_SIZE(victims[best])))
+      best = b;
+  }
+  return (best < 0) ? NULL : victim_malloc(best, request);
+}
+
+// Makes chunk the victim of the given band, and puts the band's old victim in its bin.
+static void replace_victim(unsigned int band, chunk_t* chunk) {
+  if (victims[band] != NULL)
+    insert_chunk(victims[band]);
+  victims[band] = chunk;
+}
+
 // Pseudocode - First, go to the index that would service the request. If there is a free chunk there,
 // unlink it and remove it. If that don't work, go to the next bin, and if that doesn't work, see if
 // the victim chunk is large enough. Otherwise return NULL
 //
 // Updated pseudocode - First, go to the index that would service the request. If there is a free chunk there,
-// unlink it and remove it. If that doesn't work, go to the next bin. If that doesn't work, see if the victim
-// chunk is large enough. If that doesn't work, iterate through the small bins until you find a free chunk or
-// reach the end of the small bins. If you find a free chunk, unlink it, remove it, and split. If you reach the end of
-// the bins, return NULL
-
-#ifndef SMALL_BIN_SEARCH_MAX
-#define SMALL_BIN_SEARCH_MAX (0)
-#endif
-
-#ifndef LARGE_BIN_SEARCH_MAX
-#define LARGE_BIN_SEARCH_MAX (16)
-#endif
+// unlink it and remove it. If that doesn't work, see if the small band's victim is large enough. If that doesn't
+// work, use the binmap to find the next non-empty bin (small or large). Take a chunk from it (the smallest one if
+// it is a large bin), unlink it, remove it, and split, keeping the rest as the small band's victim. If every bin
+// is empty, try the other bands' victims.
 static chunk_t* small_malloc(size_int request) {
   bin_index i = small_request_index(request);
+  #if FASTBINS
+  // A fastbin chunk is still marked in use, so it can be handed out as is.
+  if (fastbins[i] != NULL) {
+    chunk_t* fast = fastbins[i];
+    fastbins[i] = NEXT_FREE_CHUNK(fast);
+    if (fastbins[i] == NULL)
+      fastbin_map &= ~(1U << i);
+    return fast;
+  }
+  #endif
   chunk_t* result = bins[i];
   if (result != NULL) {
     remove_small_chunk(result);
     return result;
   }
   // First two bins didn't work? Try the victim
-  // Below can be consolidated into a single if statement.
-  if (VICTIM_BIN != NULL && // If it exists
-      CAN_SPLIT_CHUNK(VICTIM_BIN, request)) /* And is large enough to be split */ {
-    result = VICTIM_BIN;
-    VICTIM_BIN = split_chunk(VICTIM_BIN, request);
+  result = victim_malloc(0, request);
+  if (result != NULL)
     return result;
-  } else if (VICTIM_BIN != NULL && CHUNK_SIZE(VICTIM_BIN) >= request) {
-    result = VICTIM_BIN;
-    VICTIM_BIN = NULL;
-    return result;
-  }
-  assert(result == NULL);
-  // Trying the rest of the small bins
-  for (int j = i + 1; j < 32 && (j - i) < SMALL_BIN_SEARCH_MAX; j++) {
-    result = bins[j];
-    if (result != NULL) {
-      remove_small_chunk(result);
-      if (CAN_SPLIT_CHUNK(result, request)) {
-        if (VICTIM_BIN != NULL)
-          insert_chunk(VICTIM_BIN);
-        VICTIM_BIN = split_chunk(result, request);
-      }
-      return result;
-    }
-  }
-  assert(result == NULL);
-  if (result == NULL) {
-    // check the rest of the large bins
-    int cutoff = 0;
-    int n = 31;
-    while (n < 63 && cutoff < LARGE_BIN_SEARCH_MAX) {
-      n++;
-      cutoff++;
-      if (bins[n] != NULL) {
-        // Find smallest chunk in bin;
-        bigchunk_t* current = (bigchunk_t*) bins[n];
-        bigchunk_t* best_chunk = (bigchunk_t*) bins[n];
-        size_int best_size = CHUNK_SIZE(bins[n]);
-        while (current != NULL) {
-          if (CHUNK_SIZE(current) < best_size) {
-            best_chunk = current;
-            best_size = CHUNK_SIZE(current);
-          }
-          current = (current->children[0] != NULL) ? current->children[0] : current->children[1];
-        }
-        remove_large_chunk(best_chunk);
-        if (CAN_SPLIT_CHUNK(best_chunk, request)) {
-          if (VICTIM_BIN != NULL)
-            insert_chunk(VICTIM_BIN);
-          VICTIM_BIN = split_chunk((chunk_t*) best_chunk, request);
-        }
-        return (chunk_t*) best_chunk;
-      }
-    }
+  // Every chunk in a bin after i is large enough, so take from the first non-empty one.
+  // The binmap doesn't see unsorted chunks, so sort them first.
+  sort_unsorted_chunks(0);
+  bin_index n = next_nonempty_bin(i + 1);
+  if (n == NUM_OF_BINS)
+    return any_victim_malloc(request);
+  if (n < 32) {
+    result = bins[n];
+    remove_small_chunk(result);
+  } else {
+    result = NODE_CHUNK(LOWEST_IN_RING(smallest_chunk_in_subtree((bigchunk_t*) bins[n])));
+    remove_large_chunk(result);
   }
-  assert(result == NULL);
+  if (CAN_SPLIT_CHUNK(result, request))
+    replace_victim(0, split_chunk(result, request));
   return result;
 }
 
-static bigchunk_t* find_best_chunk(size_int request) {
+// Pseudocode - Walk down the tree in bin n following the bits of the request. Every chunk
+// that is at least as large as the request is either on this path, or in the "1" subtree of
+// a node where the request went to the "0" side. So keep the best node seen on the path,
+// and compare it against the subtree minimum of each "1" subtree we skip. At the end, if the
+// best candidate was a subtree, descend into it to find the chunk holding its minimum.
+// This gives the exact best fit in O(depth).
+// If nothing in bin n fits, take the smallest chunk of the next non-empty bin.
+static chunk_t* find_best_chunk(size_int request) {
+  STAT_TIMER(start);
   bin_index n = large_request_index(request);
   bigchunk_t* best_chunk = NULL;
-  size_int best_size = 2*request; // Guaranteed to not be in this bin.
+  bigchunk_t* best_subtree = NULL;
+  size_int best_size = (size_int) ~0ULL;
   bigchunk_t* current = (bigchunk_t*) bins[n];
+  size_int key = BIN_KEY(request);
   while (current != NULL) {
-    int decision = (request >> current->shift) & 1;
-    if (CHUNK_SIZE(current) == request) {
-      best_chunk = current;
-      break;
-    } else if (CHUNK_SIZE(current) < best_size && CHUNK_SIZE(current) > request) {
-      best_size = CHUNK_SIZE(current);
+    STAT_ADD(tree_walk_nodes, 1);
+    int decision = (key >> current->shift) & 1;
+    size_int size = NODE_SIZE(current);
+    if (size >= request && size < best_size) {
+      best_size = size;
       best_chunk = current;
+      best_subtree = NULL;
+      if (size == request)
+        break;
     }
-    if (decision == 0 && current->children[1] != NULL && CHUNK_SIZE(current->children[1]) < best_size) {
-      best_size = CHUNK_SIZE(current->children[1]);
-      best_chunk = current->children[1];
+    if (decision == 0 && SUBTREE_MIN(current->children[1]) < best_size) {
+      best_size = current->children[1]->subtree_min;
+      best_subtree = current->children[1];
+      best_chunk = NULL;
     }
     current = current->children[decision];
   }
+  if (best_subtree != NULL)
+    best_chunk = smallest_chunk_in_subtree(best_subtree);
   if (best_chunk == NULL) {
-    // check the rest of the large bins
-    int cutoff = 0;
-    while (n < 64 && cutoff < LARGE_BIN_SEARCH_MAX) {
-      n++;
-      cutoff++;
-      if (bins[n] != NULL) {
-        // Find smallest chunk in bin;
-        current = (bigchunk_t*) bins[n];
-        best_chunk = (bigchunk_t*) bins[n];
-        best_size = CHUNK_SIZE(bins[n]);
-        while (current != NULL) {
-          if (CHUNK_SIZE(current) < best_size) {
-            best_chunk = current;
-            best_size = CHUNK_SIZE(current);
-          }
-          current = (current->children[0] != NULL) ? current->children[0] : current->children[1];
-        }
-        break;
-      }
-    }
+    // Every chunk in a later large bin is large enough, so take the smallest of the first non-empty one.
+    n = next_nonempty_bin(n + 1);
+    if (n < NUM_OF_BINS)
+      best_chunk = smallest_chunk_in_subtree((bigchunk_t*) bins[n]);
   }
-  return best_chunk;
-}
-
-static chunk_t* huge_malloc(size_int request) {
-  chunk_t* start = HUGE_BIN;
-  chunk_t* current = start;
-  if (start == NULL)
+  STAT_ADD(tree_walks, 1);
+  STAT_ADD_CYCLES(tree_walk_cycles, start);
+  if (best_chunk == NULL)
     return NULL;
-  chunk_t* best_fit = NULL;
-  size_int best_size = ~0;
-  do {
-    if (CHUNK_SIZE(current) >= request && CHUNK_SIZE(current) < best_size) {
-      best_fit = current;
-      best_size = CHUNK_SIZE(current);
-      if (best_size == request)
-        break;
-    }
-    current = current->next;
-  } while (current != start);
-  if (best_fit != NULL)
-    remove_huge_chunk((bigchunk_t*) best_fit);
-  return best_fit;
+  assert(NODE_SIZE(best_chunk) >= request);
+  return NODE_CHUNK(LOWEST_IN_RING(best_chunk));
 }
 
 // Pseudocode - First go to the index that would service the request. If there no free chunk that works,
@@ -650,80 +1263,120 @@ static chunk_t* huge_malloc(size_int request) {
 //
 // Updated - First go to the index taht would service the request. If there is no free chunk that works,
 // iterate through the rest of the large bins until y
+//
+// With victim bands - Start with the victim of the request's band, and keep the rest of a
+// split best fit as that band's victim. If no bin has a fit, try the other bands' victims.
 static chunk_t* large_malloc(size_int request) {
-  if (IS_HUGE_SIZE(request)) {
-    return huge_malloc(request);
-  }
-
-  if (VICTIM_BIN != NULL && CAN_SPLIT_CHUNK(VICTIM_BIN, request)) {
-    chunk_t* result = VICTIM_BIN;
-    VICTIM_BIN = split_chunk(VICTIM_BIN, request);
-    return result;
-  } else if (VICTIM_BIN != NULL && CHUNK_SIZE(VICTIM_BIN) >= request) {
-    chunk_t* result = VICTIM_BIN;
-    VICTIM_BIN = NULL;
-    return result;
-  }
-
-  #ifdef DEBUG
-  bin_index n = large_request_index(request);
-  #endif
-  bigchunk_t* best_chunk = find_best_chunk(request);
+  unsigned int band = victim_band(request);
+  chunk_t* best_chunk = victim_malloc(band, request);
+  if (best_chunk != NULL)
+    return best_chunk;
+
+  best_chunk = sort_unsorted_chunks(request);
+  if (best_chunk != NULL)
+    return best_chunk;
+  best_chunk = find_best_chunk(request);
   if (best_chunk == NULL)
-    return NULL;
+    return any_victim_malloc(request);
   remove_large_chunk(best_chunk);
-  assert(chunk_not_in_tree((bigchunk_t*) bins[n], best_chunk));
-  assert(n > 62 || chunk_not_in_tree((bigchunk_t*) bins[n], best_chunk));
   if (CAN_SPLIT_CHUNK(best_chunk, request)) {
-    if (VICTIM_BIN != NULL)
-      insert_chunk(VICTIM_BIN);
-    VICTIM_BIN = split_chunk((chunk_t*) best_chunk, request);
+    chunk_t* rest;
+    best_chunk = carve_chunk(best_chunk, request, &rest);
+    replace_victim(band, rest);
   }
-  return (chunk_t*) best_chunk;
+  return best_chunk;
 }
 
+// Returns the slack for a heap growth that is about to happen.
+static size_int next_heap_growth() {
+  if (mallocs_since_growth <= HEAP_GROWTH_WINDOW) {
+    heap_growth = MIN(ALIGN(2 * heap_growth), HEAP_GROWTH_MAX);
+  } else if (heap_growth > EXTENSION_SIZE) {
+    heap_growth = MAX(ALIGN(heap_growth / 2), EXTENSION_SIZE);
+  }
+  mallocs_since_growth = 0;
+  return heap_growth;
+}
 
-#ifndef EXTENSION_SIZE
-#define EXTENSION_SIZE (SMALLEST_CHUNK + 320)
-#endif
+// Grows the heap by at least difference bytes, with slack on top if there is room for it.
+// Returns the number of bytes the heap grew by, or 0 if it can't grow that far.
+static size_int grow_heap(size_int difference) {
+  size_int extension = difference + next_heap_growth() - EXTENSION_SIZE;
+  // mem_sbrk can't grow the heap by more than INT_MAX at once.
+  if (extension <= INT_MAX && mem_sbrk(extension) != (void *)-1)
+    return extension;
+  // Without the slack, the heap may still have room.
+  heap_growth = EXTENSION_SIZE;
+  if (difference <= INT_MAX && mem_sbrk(difference) != (void *)-1)
+    return difference;
+  return 0;
+}
+
+// Grows the heap until the last chunk can be split into a chunk of the requested size
+// and a new last chunk. Returns false if the heap can't grow that far.
+static bool extend_end_of_heap(size_int request) {
+  if (CAN_SPLIT_CHUNK(END_OF_HEAP_BIN, request))
+    return true;
+  size_int extension = grow_heap(request - CHUNK_SIZE(END_OF_HEAP_BIN) + EXTENSION_SIZE);
+  if (extension == 0)
+    return false;
+  END_OF_HEAP_BIN->current_size += extension;
+  return true;
+}
 
 // Pseudocode - Extend the last chunk as far as needed so it can be split into two chunks
 // If it can't be extended that far, return null, otherwise split it in two.
 static chunk_t* end_of_heap_malloc(size_int request) {
-  if (!CAN_SPLIT_CHUNK(END_OF_HEAP_BIN, request)) {
-    void* new = mem_sbrk(request - CHUNK_SIZE(END_OF_HEAP_BIN) + EXTENSION_SIZE);
-    if (new == (void *)-1)
-      return NULL;
-    END_OF_HEAP_BIN->current_size += request - CHUNK_SIZE(END_OF_HEAP_BIN) + EXTENSION_SIZE;
-  }
+  if (!extend_end_of_heap(request))
+    return NULL;
   chunk_t* result = END_OF_HEAP_BIN;
   END_OF_HEAP_BIN = split_chunk(END_OF_HEAP_BIN, request);
+  RAISE_CLEAN_HEAP_START();
   return result;
 }
 
 //  malloc - Allocate a block by incrementing the brk pointer.
 //  Always allocate a block whose size is a multiple of the alignment.
 
-// Pseudocode - to malloc a block, first round up the requested size to the nearest
-// multiple of alignment, or SMALLEST_MALLOC, whichever is larger. If this requested size is smaller
+// Pseudocode - to malloc a block, first round up the requested size to a chunk size
+// (see CHUNK_REQUEST), or SMALLEST_MALLOC, whichever is larger. If this requested size is smaller
 // than the threshold, malloc a small chunk. If this requested size is larger than the
 // threshold, malloc a large chunk.
 
-#define MAX(a, b) ((a) ^ (((a) ^ (b)) & -((a) < (b))))
 
-void * my_malloc(size_t size) {
-  #ifdef VERBOSE
-  printf("============================ Malloc %lu ============================\n", size);
-  #endif
-  if (size == 0)
-    return NULL;
-  size_int aligned_size = ALIGN(size);
-  size_int request = MAX(aligned_size, SMALLEST_MALLOC);
+// Takes an already rounded request and returns a chunk of at least that size from the
+// bins, the fastbins or the victims, or NULL if it would take the end of the heap. The
+// caller marks it in use.
+static chunk_t* bin_malloc(size_int request) {
   chunk_t* result = NULL;
   if (IS_LARGE_SIZE(request))
     result = large_malloc(request);
   else
     result = small_malloc(request);
+  #if FASTBINS
+  // Before a large request gives up on the bins, or before the heap grows, see whether
+  // the fastbin chunks coalesce into something that fits.
+  if (result == NULL && fastbin_map != 0 &&
+      (IS_LARGE_SIZE(request) || !CAN_SPLIT_CHUNK(END_OF_HEAP_BIN, request))) {
+    consolidate_fastbins();
+    if (IS_LARGE_SIZE(request))
+      result = large_malloc(request);
+    else
+      result = small_malloc(request);
+  }
+  #endif
+  #if REALLOC_HEADROOM
+  if (result == NULL && headroom_count != 0 && !CAN_SPLIT_CHUNK(END_OF_HEAP_BIN, request))
+    result = headroom_malloc(request);
+  #endif
+  return result;
+}
+
+// Takes an already rounded request and returns an in-use chunk of at least that size,
+// or NULL if the heap can't grow any further.
+static chunk_t* malloc_chunk(size_int request) {
+  mallocs_since_growth++;
+  chunk_t* result = bin_malloc(request);
   if (result == NULL)
     result = end_of_heap_malloc(request);
   if (result != NULL) {
@@ -731,13 +1384,335 @@ void * my_malloc(size_t size) {
     SET_PREVIOUS_INUSE(NEXT_HEAP_CHUNK(result));
     #ifdef DEBUG
 
-    result->next = result->prev = NULL;
-    assert(CHUNK_SIZE(result) >= size);
+    SET_NEXT_FREE_CHUNK(result, NULL);
+    SET_PREV_FREE_CHUNK(result, NULL);
+    assert(CHUNK_SIZE(result) >= request);
     #endif
-    return CHUNK_TO_USER_POINTER(result);
+  }
+  return result;
+}
+
+void * my_malloc(size_t size) {
+  #ifdef VERBOSE
+  printf("============================ Malloc %lu ============================\n", size);
+  #endif
+  if (size == 0 || IS_TOO_LARGE_SIZE(size))
+    return NULL;
+  size_int request = CHUNK_REQUEST(size);
+  #if SLAB_ALLOCATOR
+  // Slab objects have no header, so their classes go by the aligned size alone.
+  size_int object_size = MAX(ALIGN(size), ALIGN(SLAB_SMALLEST_OBJECT));
+  bool counted = false;
+  if (IS_SMALL_SIZE(object_size)) {
+    if (is_busy_slab_class(object_size)) {
+      void* object = slab_malloc(0, object_size);
+      if (object != NULL)
+        return object;
+    } else {
+      counted = true;
+    }
+  }
+  #endif
+  chunk_t* result = malloc_chunk(request);
+  if (result == NULL)
+    return NULL;
+  #if SLAB_ALLOCATOR
+  if (counted)
+    count_small_chunk(result, object_size);
+  #endif
+  return CHUNK_TO_USER_POINTER(result);
+}
+
+// malloc_hint - malloc with MALLOC_HINT_ flags saying how the block will be used. A cold
+// block goes with the cold ones whatever its lifetime, and a block hinted both short and
+// long-lived is taken as short-lived. Hinted blocks are freed and realloc'd as usual.
+// Pseudocode - Sizes slab runs serve come from the hint class's own runs if the class is
+// in HINT_SLAB_CLASSES. Anything else is carved from the class's arena, taking the holes
+// in the bins first unless the class is in HINT_ARENA_FIRST_CLASSES. If the arena is too
+// small, take a new one.
+void* my_malloc_hint(size_t size, int flags) {
+  unsigned int hint = MALLOC_HINT_CLASS(flags);
+  if (hint == 0)
+    return my_malloc(size);
+  if (size == 0 || IS_TOO_LARGE_SIZE(size))
+    return NULL;
+  STAT_ADD(hint_mallocs[hint], 1);
+  #if SLAB_ALLOCATOR
+  size_int object_size = MAX(ALIGN(size), ALIGN(SLAB_SMALLEST_OBJECT));
+  bool counted = false;
+  if (IS_SMALL_SIZE(object_size) && ((HINT_SLAB_CLASSES >> hint) & 1)) {
+    if (is_busy_slab_class(object_size)) {
+      void* object = slab_malloc(HINT_SLAB_LIST(hint), object_size);
+      if (object != NULL)
+        return object;
+    } else {
+      counted = true;
+    }
+  }
+  #endif
+  size_int request = CHUNK_REQUEST(size);
+  #if HINT_ARENAS
+  chunk_t* result = victim_malloc(HINT_VICTIM(hint), request);
+  if (result == NULL && !((HINT_ARENA_FIRST_CLASSES >> hint) & 1))
+    result = bin_malloc(request);
+  if (result == NULL)
+    result = hint_arena_malloc(hint, request);
+  if (result == NULL)
+    return NULL;
+  mallocs_since_growth++;
+  SET_CURRENT_INUSE(result);
+  SET_PREVIOUS_INUSE(NEXT_HEAP_CHUNK(result));
+  #else
+  chunk_t* result = malloc_chunk(request);
+  if (result == NULL)
+    return NULL;
+  #endif
+  #if SLAB_ALLOCATOR
+  if (counted)
+    count_small_chunk(result, object_size);
+  #endif
+  return CHUNK_TO_USER_POINTER(result);
+}
+
+#if HINT_ARENAS
+// Gives the hint class a new arena with room for the request and mallocs the request from
+// it. The class's old arena goes in a bin. Returns NULL if the heap is out of memory.
+// Pseudocode - Take the best fit from the bins (freeing the fastbin chunks for real if
+// there is none) and carve the request off its front. The whole chunk is the arena, as
+// splitting it would leave two free chunks side by side. If no bin chunk is big enough, take the arena from the end of the heap and carve the request
+// off its back instead, since the chunk right below the end of the heap has to stay in
+// use. Once the class frees that block, the arena goes back to the end of the heap.
+static chunk_t* hint_arena_malloc(unsigned int hint, size_int request) {
+  size_int size = MAX(request, CHUNK_REQUEST(HINT_ARENA_SIZE));
+  sort_unsorted_chunks(0);
+  chunk_t* arena = find_best_chunk(size);
+  #if FASTBINS
+  if (arena == NULL && fastbin_map != 0) {
+    consolidate_fastbins();
+    sort_unsorted_chunks(0);
+    arena = find_best_chunk(size);
+  }
+  #endif
+  if (arena != NULL) {
+    remove_large_chunk(arena);
+    replace_victim(HINT_VICTIM(hint), arena);
+    STAT_ADD(hint_arenas[hint], 1);
+    return victim_malloc(HINT_VICTIM(hint), request);
+  }
+  arena = end_of_heap_malloc(size);
+  if (arena == NULL || !CAN_SPLIT_CHUNK(arena, request))
+    return arena;
+  chunk_t* result = split_chunk_tail(arena, request);
+  replace_victim(HINT_VICTIM(hint), arena);
+  STAT_ADD(hint_arenas[hint], 1);
+  return result;
+}
+#endif
+
+#define HAS_ALIGNED_FIT(chunk_ptr, alignment, request) \
+  (ALIGN_POINTER_UP((uint64_t) CHUNK_TO_USER_POINTER(chunk_ptr), alignment) + (request) <= \
+   (uint64_t) CHUNK_TO_USER_POINTER(chunk_ptr) + CHUNK_SIZE(chunk_ptr))
+
+// Returns the smallest chunk in the tree rooted at root with room for an aligned request.
+// Unlike a plain best fit this has to look at every chunk, since whether a chunk fits
+// depends on its address and not just its size.
+static bigchunk_t* smallest_aligned_fit_in_tree(bigchunk_t* root, size_int alignment, size_int request) {
+  if (root == NULL)
+    return NULL;
+  bigchunk_t* best = NULL;
+  bigchunk_t* current = root;
+  do {
+    if (HAS_ALIGNED_FIT(NODE_CHUNK(current), alignment, request)) {
+      best = current;
+      break;
+    }
+    current = current->next;
+  } while (current != root);
+  for (int i = 0; i < 2; i++) {
+    bigchunk_t* candidate = smallest_aligned_fit_in_tree(root->children[i], alignment, request);
+    if (candidate != NULL && (best == NULL || NODE_SIZE(candidate) < NODE_SIZE(best)))
+      best = candidate;
+  }
+  return best;
+}
+
+// Pseudocode - Use a victim if one has room for an aligned request. Otherwise go through
+// the non-empty bins from the request's bin upwards, and return the smallest chunk with
+// room from the first bin that has one.
+static chunk_t* find_aligned_chunk(size_int alignment, size_int request) {
+  for (int b = 0; b < NUM_OF_VICTIMS; b++)
+    if (victims[b] != NULL && HAS_ALIGNED_FIT(victims[b], alignment, request))
+      return victims[b];
+  sort_unsorted_chunks(0);
+  bin_index n = IS_LARGE_SIZE(request) ? large_request_index(request) : small_request_index(request);
+  for (n = next_nonempty_bin(n); n < NUM_OF_BINS; n = next_nonempty_bin(n + 1)) {
+    if (n < 32) {
+      chunk_t* current = bins[n];
+      do {
+        if (HAS_ALIGNED_FIT(current, alignment, request))
+          return current;
+        current = NEXT_FREE_CHUNK(current);
+      } while (current != bins[n]);
+    } else {
+      bigchunk_t* best = smallest_aligned_fit_in_tree((bigchunk_t*) bins[n], alignment, request);
+      if (best != NULL)
+        return NODE_CHUNK(best);
+    }
   }
   return NULL;
 }
+
+// Pseudocode - Find a free chunk that contains an aligned user pointer with room for the
+// request, where the pointer is either the chunk's own user pointer, or far enough in that
+// the bytes in front of it make a chunk of their own. Turn those bytes into an in-use chunk
+// and free it, then give back whatever is left past the request like a shrinking realloc.
+//
+// If no free chunk has room, the end of the heap is aligned instead (see
+// aligned_end_of_heap_malloc).
+static chunk_t* aligned_malloc_chunk(size_int alignment, size_int request) {
+  assert(alignment >= ALIGNMENT && (alignment & (alignment - 1)) == 0);
+  chunk_t* chunk = find_aligned_chunk(alignment, request);
+  #if FASTBINS
+  if (chunk == NULL && fastbin_map != 0) {
+    consolidate_fastbins();
+    chunk = find_aligned_chunk(alignment, request);
+  }
+  #endif
+  if (chunk == NULL)
+    return aligned_end_of_heap_malloc(alignment, request);
+  remove_chunk_or_victim(chunk);
+  SET_CURRENT_INUSE(chunk);
+  SET_PREVIOUS_INUSE(NEXT_HEAP_CHUNK(chunk));
+  uint64_t user = (uint64_t) CHUNK_TO_USER_POINTER(chunk);
+  uint64_t aligned = ALIGN_POINTER_UP(user, alignment);
+  if (aligned != user) {
+    chunk_t* result = USER_POINTER_TO_CHUNK(aligned);
+    size_int leading = aligned - user - sizeof(size_int);
+    size_int rest = CHUNK_SIZE(chunk) - leading - sizeof(size_int);
+    chunk->current_size = leading | IS_PREVIOUS_INUSE(chunk) | CURRENT_CHUNK_INUSE;
+    result->current_size = rest | PREVIOUS_CHUNK_INUSE | CURRENT_CHUNK_INUSE;
+    assert(NEXT_HEAP_CHUNK(chunk) == result);
+    my_free(CHUNK_TO_USER_POINTER(chunk));
+    chunk = result;
+  }
+  assert(CHUNK_SIZE(chunk) >= request);
+  realloc_chunk_is_smaller(CHUNK_TO_USER_POINTER(chunk), request);
+  return chunk;
+}
+
+// Pseudocode - Split a free chunk off the front of the last chunk so that the last chunk's
+// user pointer is aligned, put it in a bin, and malloc from the end of the heap as usual.
+static chunk_t* aligned_end_of_heap_malloc(size_int alignment, size_int request) {
+  uint64_t user = (uint64_t) CHUNK_TO_USER_POINTER(END_OF_HEAP_BIN);
+  uint64_t aligned = ALIGN_POINTER_UP(user, alignment);
+  if (aligned != user) {
+    size_int leading = aligned - user - sizeof(size_int);
+    if (!extend_end_of_heap(leading))
+      return NULL;
+    assert(IS_PREVIOUS_INUSE(END_OF_HEAP_BIN));
+    chunk_t* front = END_OF_HEAP_BIN;
+    END_OF_HEAP_BIN = split_chunk(front, leading);
+    RAISE_CLEAN_HEAP_START();
+    insert_chunk(front);
+  }
+  chunk_t* result = end_of_heap_malloc(request);
+  if (result == NULL)
+    return NULL;
+  SET_CURRENT_INUSE(result);
+  SET_PREVIOUS_INUSE(NEXT_HEAP_CHUNK(result));
+  assert(CHUNK_TO_USER_POINTER(result) == (void*) aligned);
+  return result;
+}
+
+// memalign - Allocate a block whose address is a multiple of alignment, which has to be a
+// power of two. The block is an ordinary chunk, so free and realloc take it as usual.
+// Pseudocode - Alignments up to ALIGNMENT are plain mallocs. Otherwise carve the aligned
+// chunk out of the bins (or the end of the heap) with aligned_malloc_chunk, which hands
+// the slack before and after it back as free chunks.
+void * my_memalign(size_t alignment, size_t size) {
+  if (size == 0 || (alignment & (alignment - 1)) != 0 || IS_TOO_LARGE_SIZE(size + alignment))
+    return NULL;
+  if (alignment <= ALIGNMENT)
+    return my_malloc(size);
+  chunk_t* result = aligned_malloc_chunk(alignment, CHUNK_REQUEST(size));
+  if (result == NULL)
+    return NULL;
+  return CHUNK_TO_USER_POINTER(result);
+}
+
+// calloc - Allocate a zeroed block of nmemb * size bytes.
+// Pseudocode - Malloc the block, remembering where the clean part of the heap started
+// before the malloc. Clear the bytes below that. Past it the block came out of the front
+// of the last chunk and is zero, except for its last size_int, which the split used as
+// the new last chunk's previous_size. Slab objects are always cleared.
+void * my_calloc(size_t nmemb, size_t size) {
+  size_t total;
+  if (__builtin_mul_overflow(nmemb, size, &total))
+    return NULL;
+  #if CALLOC_KNOWN_ZERO
+  uint64_t clean = clean_heap_start;
+  #endif
+  char* ptr = my_malloc(total);
+  if (ptr == NULL)
+    return NULL;
+  size_t dirty = total;
+  #if CALLOC_KNOWN_ZERO
+  #if SLAB_ALLOCATOR
+  bool known_zero = !IS_SLAB_POINTER(ptr);
+  #else
+  bool known_zero = true;
+  #endif
+  if (known_zero) {
+    if ((uint64_t) ptr >= clean)
+      dirty = 0;
+    else if (clean - (uint64_t) ptr < total)
+      dirty = clean - (uint64_t) ptr;
+    size_t size_tag = CHUNK_SIZE(USER_POINTER_TO_CHUNK(ptr)) - sizeof(size_int);
+    if (total > size_tag)
+      memset(ptr + MAX(dirty, size_tag), 0, total - MAX(dirty, size_tag));
+  }
+  #endif
+  memset(ptr, 0, dirty);
+  STAT_ADD(calloc_bytes_zeroed, dirty);
+  STAT_ADD(calloc_bytes_clean, total - dirty);
+  return ptr;
+}
+
+// malloc_usable_size - The number of bytes the block at ptr can hold, at least the size it
+// was allocated with. The caller owns all of them and can grow into them without a realloc.
+size_t my_malloc_usable_size(void* ptr) {
+  if (ptr == NULL)
+    return 0;
+  #if SLAB_ALLOCATOR
+  if (IS_SLAB_POINTER(ptr))
+    return SLAB_RUN_OF(ptr)->object_size;
+  #endif
+  return CHUNK_SIZE(USER_POINTER_TO_CHUNK(ptr));
+}
+
+// good_size - The size a malloc of size bytes rounds up to, so that callers can ask for
+// that much in the first place. my_malloc gives small sizes a slab object of their
+// aligned size once their bin is busy and a chunk of CHUNK_REQUEST(size) before that, so
+// they only get the smaller of the two for sure. A malloc can still hand back more, when
+// what is left of the chunk it found is too small to split off.
+size_t my_good_size(size_t size) {
+  if (size == 0 || IS_TOO_LARGE_SIZE(size))
+    return size;
+  #if SLAB_ALLOCATOR
+  size_int object_size = MAX(ALIGN(size), ALIGN(SLAB_SMALLEST_OBJECT));
+  if (IS_SMALL_SIZE(object_size))
+    return MIN(object_size, CHUNK_REQUEST(size));
+  #endif
+  return CHUNK_REQUEST(size);
+}
+
+// malloc_at_least - malloc that also stores the block's usable size in *usable_size, or 0
+// if it fails.
+void * my_malloc_at_least(size_t size, size_t* usable_size) {
+  void* ptr = my_malloc(size);
+  *usable_size = my_malloc_usable_size(ptr);
+  return ptr;
+}
 // [END MALLOC METHODS]
 /* ------------------------------------------------------------------------- */
 
@@ -759,8 +1734,9 @@ static chunk_t* combine_chunks(chunk_t* left, chunk_t* right) {
     // "Free" bit should already be set, otherwise we wouldn't be combining.
     assert(IS_PREVIOUS_FREE(NEXT_HEAP_CHUNK(right)));
   }
-  if (VICTIM_BIN == left || VICTIM_BIN == right)
-    VICTIM_BIN = NULL;
+  for (int b = 0; b < NUM_OF_VICTIMS; b++)
+    if (victims[b] == left || victims[b] == right)
+      victims[b] = NULL;
   left->current_size = combined | IS_PREVIOUS_INUSE(left);
   assert(IS_CURRENT_FREE(left));
   return left;
@@ -784,42 +1760,365 @@ Otherwise, insert this new chunk into the corresponding bin.
 
 Finally, clear the PREVIOUS_INUSE bit of the next chunk, and write the previous_size of the next chunk.
 */
-
-void my_free(void *ptr) {
-  #ifdef VERBOSE
-  printf("============================ Free ============================\n");
+static void free_chunk(chunk_t* chunk) {
+  #if REALLOC_HEADROOM
+  // A block's reserve is freed with it, first, so the block coalesces with it.
+  if (headroom_count != 0 && !IS_END_OF_HEAP(chunk)) {
+    int slot = headroom_slot(NEXT_HEAP_CHUNK(chunk));
+    if (slot >= 0)
+      release_headroom(slot);
+  }
   #endif
-  chunk_t* chunk = USER_POINTER_TO_CHUNK(ptr);
-  chunk->next = chunk->prev = NULL;
+  SET_NEXT_FREE_CHUNK(chunk, NULL);
+  SET_PREV_FREE_CHUNK(chunk, NULL);
+  CLEAR_REALLOC_GROWN(chunk);
   CLEAR_CURRENT_INUSE(chunk);
   CLEAR_PREVIOUS_INUSE(NEXT_HEAP_CHUNK(chunk));
   NEXT_HEAP_CHUNK(chunk)->previous_size = CHUNK_SIZE(chunk);
   bool was_end_of_heap = IS_END_OF_HEAP(chunk);
+  int band = -1; // The band of a victim chunk was combined with
   if (CAN_COMBINE_PREVIOUS(chunk)) { // This order is important, since the next chunk has to have the size at the end;
     chunk_t* prev_chunk = PREVIOUS_HEAP_CHUNK(chunk);
-    remove_chunk_or_victim(prev_chunk);
+    band = remove_chunk_or_victim(prev_chunk);
     chunk = combine_chunks(prev_chunk, chunk);
   }
   if (CAN_COMBINE_NEXT(chunk)) {
     chunk_t* next_chunk = NEXT_HEAP_CHUNK(chunk);
-    if (!IS_END_OF_HEAP(next_chunk) && IS_LARGE_CHUNK(next_chunk) && !IS_HUGE_CHUNK(next_chunk) && !IS_VICTIM(next_chunk)) {
-      assert(IS_VALID_LARGE_CHUNK((bigchunk_t*)next_chunk));
+    if (!IS_END_OF_HEAP(next_chunk) && IS_LARGE_CHUNK(next_chunk) && !IS_VICTIM(next_chunk) && !IS_UNSORTED(next_chunk)) {
+      assert(IS_VALID_LARGE_CHUNK(LARGE_NODE(next_chunk)));
+    }
+    if (!IS_END_OF_HEAP(next_chunk)) {
+      int next_band = remove_chunk_or_victim(next_chunk);
+      if (!IS_HINT_VICTIM(band))
+        band = next_band;
     }
-    if (!IS_END_OF_HEAP(next_chunk))
-      remove_chunk_or_victim(next_chunk);
     if (IS_END_OF_HEAP(next_chunk))
       was_end_of_heap = true;
     chunk = combine_chunks(chunk, next_chunk);
   }
   if (was_end_of_heap) {
     END_OF_HEAP_BIN = chunk;
+  } else if (IS_HINT_VICTIM(band)) {
+    // A hint class's arena takes back what the objects next to it free.
+    victims[band] = chunk;
+  } else if (IS_LARGE_CHUNK(chunk)) {
+    // The next malloc may well want this chunk back, so don't sort it into its bin yet.
+    insert_unsorted_chunk(chunk);
   } else {
     insert_chunk(chunk);
   }
+}
+
+// Pseudocode - Slab objects go back to their run. Small chunks that aren't right before
+// the end of the heap go on their fastbin untouched. Everything else is coalesced and
+// binned by free_chunk.
+void my_free(void *ptr) {
+  #ifdef VERBOSE
+  printf("============================ Free ============================\n");
+  #endif
+  #if SLAB_ALLOCATOR
+  if (IS_SLAB_POINTER(ptr)) {
+    slab_free(ptr);
+    return;
+  }
+  #endif
+  chunk_t* chunk = USER_POINTER_TO_CHUNK(ptr);
+  #if SLAB_ALLOCATOR
+  forget_small_chunk(chunk);
+  #endif
+  #if FASTBINS
+  if (IS_FAST_SIZE(CHUNK_SIZE(chunk)) && !IS_END_OF_HEAP(NEXT_HEAP_CHUNK(chunk))
+      #if REALLOC_HEADROOM
+      && (headroom_count == 0 || headroom_slot(NEXT_HEAP_CHUNK(chunk)) < 0)
+      #endif
+      ) {
+    bin_index n = small_request_index(CHUNK_SIZE(chunk));
+    CLEAR_REALLOC_GROWN(chunk);
+    SET_NEXT_FREE_CHUNK(chunk, fastbins[n]);
+    fastbins[n] = chunk;
+    fastbin_map |= 1U << n;
+    return;
+  }
+  #endif
+  free_chunk(chunk);
+  #ifdef DEBUG
+
+  #endif
+}
+
+// free_sized - free for callers that know the size they last malloc'd or realloc'd the
+// block to, like C++ sized delete. A slab object's class is the aligned size, and a
+// chunk is at least the request but never a whole chunk more, since anything that big is
+// split off.
+// Pseudocode - A size too big for every slab class can't be a slab object, and its chunk
+// is too big for a fastbin, so skip the slab page map and the fastbin test and go
+// straight to free_chunk. Smaller sizes take the plain free path. That is all the size
+// saves: the chunk's slack is unknown, so free_chunk still reads the header for the next
+// chunk's address, and the bin goes by the size after coalescing.
+void my_free_sized(void *ptr, size_t size) {
+  size_int object_size = MAX(ALIGN(size), ALIGN(SLAB_SMALLEST_OBJECT));
   #ifdef DEBUG
+  #if SLAB_ALLOCATOR
+  if (IS_SLAB_POINTER(ptr)) {
+    assert(SLAB_RUN_OF(ptr)->object_size == object_size);
+  } else
+  #endif
+  {
+    assert(CHUNK_SIZE(USER_POINTER_TO_CHUNK(ptr)) >= CHUNK_REQUEST(size));
+    assert(CHUNK_SIZE(USER_POINTER_TO_CHUNK(ptr)) < CHUNK_REQUEST(size) + SMALLEST_CHUNK);
+  }
+  #endif
+  if (IS_SMALL_SIZE(object_size)) {
+    my_free(ptr);
+    return;
+  }
+  assert(!IS_FAST_SIZE(CHUNK_SIZE(USER_POINTER_TO_CHUNK(ptr))));
+  free_chunk(USER_POINTER_TO_CHUNK(ptr));
+}
+
+// Writes count in-use chunks of request bytes over the front of a free chunk that is in no
+// bin, and stores their user pointers in out. Returns what is left of the free chunk, or
+// NULL if that would be too small to be a chunk, in which case the last chunk takes it.
+static chunk_t* carve_batch(chunk_t* chunk, size_int request, size_t count, void** out) {
+  size_int stride = request + sizeof(size_int);
+  size_int size = CHUNK_SIZE(chunk);
+  assert(size + sizeof(size_int) >= count * stride);
+  bool keep_rest = size >= count * stride + SMALLEST_MALLOC;
+  size_int previous_inuse = IS_PREVIOUS_INUSE(chunk);
+  for (size_t i = 0; i < count; i++) {
+    size_int chunk_size = (i + 1 < count || keep_rest) ? request : size - i * stride;
+    chunk->current_size = chunk_size | previous_inuse | CURRENT_CHUNK_INUSE;
+    out[i] = CHUNK_TO_USER_POINTER(chunk);
+    previous_inuse = PREVIOUS_CHUNK_INUSE;
+    chunk = NEXT_HEAP_CHUNK(chunk);
+  }
+  STAT_ADD(batch_chunks_carved, count);
+  if (!keep_rest) {
+    SET_PREVIOUS_INUSE(chunk);
+    return NULL;
+  }
+  chunk->current_size = (size - count * stride) | PREVIOUS_CHUNK_INUSE;
+  return chunk;
+}
+
+// malloc_batch - malloc n blocks of the same size, storing them in out. Returns how many
+// it got, which is less than n only when the heap is out of memory.
+// Pseudocode - Sizes slab runs serve go through my_malloc one by one, since a slab
+// object is already just a bit taken from a run. For anything else, malloc_chunk places
+// one block where a plain malloc would, so holes in the heap still get filled first. If
+// the block was split off a bigger chunk, the rest of that chunk (a victim, a binned
+// chunk, or the end of the heap, grown as needed) follows right after it, and as many of
+// the remaining blocks as fit are carved from it in one pass, with no bin lookups.
+size_t my_malloc_batch(size_t size, size_t n, void** out) {
+  if (size == 0 || IS_TOO_LARGE_SIZE(size))
+    return 0;
+  #if SLAB_ALLOCATOR
+  size_int object_size = MAX(ALIGN(size), ALIGN(SLAB_SMALLEST_OBJECT));
+  if (IS_SMALL_SIZE(object_size)) {
+    size_t done = 0;
+    while (done < n && (out[done] = my_malloc(size)) != NULL)
+      done++;
+    return done;
+  }
+  #endif
+  size_int request = CHUNK_REQUEST(size);
+  size_int stride = request + sizeof(size_int);
+  size_t done = 0;
+  while (done < n) {
+    chunk_t* chunk = malloc_chunk(request);
+    if (chunk == NULL)
+      break;
+    out[done++] = CHUNK_TO_USER_POINTER(chunk);
+    chunk_t* next = NEXT_HEAP_CHUNK(chunk);
+    if (done == n || IS_CURRENT_INUSE(next))
+      continue;
+    size_t count = n - done;
+    if (IS_END_OF_HEAP(next)) {
+      if (count > LARGEST_CHUNK_SIZE / stride)
+        count = LARGEST_CHUNK_SIZE / stride;
+      if (!extend_end_of_heap(count * stride - sizeof(size_int)))
+        continue;
+      END_OF_HEAP_BIN = carve_batch(next, request, count, out + done);
+      assert(END_OF_HEAP_BIN != NULL);
+      RAISE_CLEAN_HEAP_START();
+    } else {
+      if (count > (CHUNK_SIZE(next) + sizeof(size_int)) / stride)
+        count = (CHUNK_SIZE(next) + sizeof(size_int)) / stride;
+      if (count == 0)
+        continue;
+      int band = victim_index(next);
+      remove_chunk_or_victim(next);
+      chunk_t* rest = carve_batch(next, request, count, out + done);
+      if (rest != NULL) {
+        NEXT_HEAP_CHUNK(rest)->previous_size = CHUNK_SIZE(rest);
+        // A size band's victim that shrank below the band's requests goes to its bin.
+        if (band >= 0 && (IS_HINT_VICTIM(band) || victim_band(CHUNK_SIZE(rest)) >= (unsigned int) band))
+          victims[band] = rest;
+        else
+          insert_chunk(rest);
+      }
+    }
+    done += count;
+  }
+  return done;
+}
+
+// A chunk free_batch is about to free has its CURRENT_INUSE bit cleared, but the chunk
+// after it still has its PREVIOUS_INUSE bit set. In a truly free chunk both are clear.
+#define IS_BATCH_MARKED(chunk_ptr) \
+  (IS_CURRENT_FREE(chunk_ptr) && !IS_END_OF_HEAP(chunk_ptr) && IS_PREVIOUS_INUSE(NEXT_HEAP_CHUNK(chunk_ptr)))
+
+// free_batch - free n blocks at once. ptrs is used as scratch space.
+// Pseudocode - Slab objects go straight back to their runs. Every other chunk is then marked
+// (see IS_BATCH_MARKED), and then each marked chunk swallows the marked chunks that follow
+// it in the heap, whose headers are zeroed so they can be told apart. What is left are
+// the first chunks of runs of neighbours, each a single chunk now, and each is coalesced
+// and binned by one my_free. Walking the boundary tags finds the neighbours without
+// sorting ptrs by address.
+void my_free_batch(void** ptrs, size_t n) {
+  size_t chunks = 0;
+  // Freeing a slab object can free its run's chunk too, so do that before any marks.
+  for (size_t i = 0; i < n; i++) {
+    #if SLAB_ALLOCATOR
+    if (IS_SLAB_POINTER(ptrs[i])) {
+      slab_free(ptrs[i]);
+      continue;
+    }
+    #endif
+    ptrs[chunks++] = ptrs[i];
+  }
+  // Merging rewrites the headers, so take counted chunks off the slab counts first.
+  for (size_t i = 0; i < chunks; i++) {
+    assert(IS_CURRENT_INUSE(USER_POINTER_TO_CHUNK(ptrs[i])));
+    #if SLAB_ALLOCATOR
+    forget_small_chunk(USER_POINTER_TO_CHUNK(ptrs[i]));
+    #endif
+    CLEAR_CURRENT_INUSE(USER_POINTER_TO_CHUNK(ptrs[i]));
+  }
+  for (size_t i = 0; i < chunks; i++) {
+    chunk_t* chunk = USER_POINTER_TO_CHUNK(ptrs[i]);
+    if (chunk->current_size == 0)
+      continue;
+    chunk_t* next = NEXT_HEAP_CHUNK(chunk);
+    if (!IS_BATCH_MARKED(next))
+      continue;
+    do {
+      chunk_t* after = NEXT_HEAP_CHUNK(next);
+      next->current_size = 0;
+      next = after;
+      STAT_ADD(batch_chunks_merged, 1);
+    } while (IS_BATCH_MARKED(next));
+    chunk->current_size = ((char*) next - (char*) chunk - sizeof(size_int)) | IS_PREVIOUS_INUSE(chunk);
+  }
+  // Only free once every merge is done: freeing writes into the payloads that hold the
+  // zeroed headers.
+  size_t runs = 0;
+  for (size_t i = 0; i < chunks; i++)
+    if (USER_POINTER_TO_CHUNK(ptrs[i])->current_size != 0)
+      ptrs[runs++] = ptrs[i];
+  for (size_t i = 0; i < runs; i++) {
+    SET_CURRENT_INUSE(USER_POINTER_TO_CHUNK(ptrs[i]));
+    my_free(ptrs[i]);
+  }
+}
+
+#if FASTBINS
+// Frees every fastbin chunk for real, coalescing it with its free neighbours.
+static void consolidate_fastbins() {
+  while (fastbin_map != 0) {
+    bin_index n = __builtin_ctz(fastbin_map);
+    chunk_t* chunk = fastbins[n];
+    fastbins[n] = NULL;
+    fastbin_map &= ~(1U << n);
+    while (chunk != NULL) {
+      chunk_t* next = NEXT_FREE_CHUNK(chunk);
+      free_chunk(chunk);
+      chunk = next;
+    }
+  }
+  STAT_ADD(fastbin_consolidations, 1);
+}
+#endif
+
+/* ------------------------------------------------------------------------- */
+// [START COPY METHODS]
+// Every copy here is also a correct move when dst is below src, however much the two
+// overlap: each step loads its source before it stores, and stores only below the next
+// step's source. The kernels load their unaligned first and last vectors before
+// anything is stored and store them last. This is what realloc_chunk_and_before needs
+// when it slides a block down into the free chunk before it.
+
+#if COPY_ENGINE
+// Pseudocode - Load the first and last 16 bytes. Copy the aligned 16 byte blocks in
+// between, four at a time while there are four left, with streaming stores. Then store
+// the first and last 16 bytes, which also cover the ends.
+static void copy_sse2(char* dst, const char* src, size_t size) {
+  __m128i head = _mm_loadu_si128((const __m128i*) src);
+  __m128i tail = _mm_loadu_si128((const __m128i*) (src + size - 16));
+  size_t skip = 16 - ((uint64_t) dst & 15);
+  char* d = dst + skip;
+  const char* s = src + skip;
+  char* end = dst + size - 16;
+  for (; d + 48 < end; d += 64, s += 64) {
+    __m128i v0 = _mm_loadu_si128((const __m128i*) s);
+    __m128i v1 = _mm_loadu_si128((const __m128i*) (s + 16));
+    __m128i v2 = _mm_loadu_si128((const __m128i*) (s + 32));
+    __m128i v3 = _mm_loadu_si128((const __m128i*) (s + 48));
+    _mm_stream_si128((__m128i*) d, v0);
+    _mm_stream_si128((__m128i*) (d + 16), v1);
+    _mm_stream_si128((__m128i*) (d + 32), v2);
+    _mm_stream_si128((__m128i*) (d + 48), v3);
+  }
+  for (; d < end; d += 16, s += 16)
+    _mm_stream_si128((__m128i*) d, _mm_loadu_si128((const __m128i*) s));
+  _mm_sfence();
+  _mm_storeu_si128((__m128i*) dst, head);
+  _mm_storeu_si128((__m128i*) end, tail);
+}
+
+// The same as copy_sse2 with 32 byte blocks.
+__attribute__((target("avx2")))
+static void copy_avx2(char* dst, const char* src, size_t size) {
+  __m256i head = _mm256_loadu_si256((const __m256i*) src);
+  __m256i tail = _mm256_loadu_si256((const __m256i*) (src + size - 32));
+  size_t skip = 32 - ((uint64_t) dst & 31);
+  char* d = dst + skip;
+  const char* s = src + skip;
+  char* end = dst + size - 32;
+  for (; d + 96 < end; d += 128, s += 128) {
+    __m256i v0 = _mm256_loadu_si256((const __m256i*) s);
+    __m256i v1 = _mm256_loadu_si256((const __m256i*) (s + 32));
+    __m256i v2 = _mm256_loadu_si256((const __m256i*) (s + 64));
+    __m256i v3 = _mm256_loadu_si256((const __m256i*) (s + 96));
+    _mm256_stream_si256((__m256i*) d, v0);
+    _mm256_stream_si256((__m256i*) (d + 32), v1);
+    _mm256_stream_si256((__m256i*) (d + 64), v2);
+    _mm256_stream_si256((__m256i*) (d + 96), v3);
+  }
+  for (; d < end; d += 32, s += 32)
+    _mm256_stream_si256((__m256i*) d, _mm256_loadu_si256((const __m256i*) s));
+  _mm_sfence();
+  _mm256_storeu_si256((__m256i*) dst, head);
+  _mm256_storeu_si256((__m256i*) end, tail);
+}
+#endif
 
+// Copies size bytes from src to dst, where dst doesn't overlap src or is below it.
+// There are no inline or vector tiers for small and medium moves: a word loop lost to
+// memmove from 64 bytes up, and AVX2 and SSE2 loops with ordinary stores lost at 512
+// bytes and 16 KiB, so memmove does everything below COPY_STREAM_MIN.
+static inline void copy_payload(void* dst, const void* src, size_t size) {
+  assert((char*) dst <= (char*) src || (char*) dst >= (char*) src + size);
+  #if COPY_ENGINE
+  if (size >= COPY_STREAM_MIN) {
+    copy_kernel(dst, src, size);
+    return;
+  }
   #endif
+  memmove(dst, src, size);
 }
+// [END COPY METHODS]
+/* ------------------------------------------------------------------------- */
 
 static void* default_realloc(void* ptr, size_t size) {
   void *newptr;
@@ -830,7 +2129,7 @@ static void* default_realloc(void* ptr, size_t size) {
   // address we returned.  Now we can back up by that many bytes and read
   // the size.
   copy_size = CHUNK_SIZE(USER_POINTER_TO_CHUNK(ptr));
-  if (copy_size == size)
+  if (copy_size == CHUNK_REQUEST(size))
     return ptr;
 
   // Allocate a new chunk of memory, and fail if that allocation fails.
@@ -843,8 +2142,7 @@ static void* default_realloc(void* ptr, size_t size) {
   if (size < copy_size)
     copy_size = size;
 
-  // This is a standard library call that performs a simple memory copy.
-  memcpy(newptr, ptr, copy_size);
+  copy_payload(newptr, ptr, copy_size);
 
   // Release the old block.
   my_free(ptr);
@@ -871,6 +2169,14 @@ static chunk_t* split_mallocd_chunk(chunk_t* chunk, size_int size) {
 static void* realloc_chunk_is_smaller(void* ptr, size_t size) {
   chunk_t* chunk = USER_POINTER_TO_CHUNK(ptr);
   if (CAN_SPLIT_CHUNK(chunk, size)) {
+    #if REALLOC_HEADROOM
+    // A shrinking block is done growing, so free its reserve to coalesce with the split.
+    if (headroom_count != 0 && !IS_END_OF_HEAP(NEXT_HEAP_CHUNK(chunk))) {
+      int slot = headroom_slot(NEXT_HEAP_CHUNK(chunk));
+      if (slot >= 0)
+        release_headroom(slot);
+    }
+    #endif
     chunk_t* splitted_chunk = split_mallocd_chunk(chunk, size);
     bool was_end_of_heap = false;
     // To reduce fragmentation, and to preserve the invariant that no two free chunks are
@@ -882,10 +2188,13 @@ static void* realloc_chunk_is_smaller(void* ptr, size_t size) {
         remove_chunk_or_victim(next_chunk);
       splitted_chunk = combine_chunks(splitted_chunk, next_chunk);
     }
-    if (!was_end_of_heap)
+    if (!was_end_of_heap) {
       insert_chunk(splitted_chunk);
-    else
+      CLEAR_PREVIOUS_INUSE(NEXT_HEAP_CHUNK(splitted_chunk));
+      NEXT_HEAP_CHUNK(splitted_chunk)->previous_size = CHUNK_SIZE(splitted_chunk);
+    } else {
       END_OF_HEAP_BIN = splitted_chunk;
+    }
   }
   return CHUNK_TO_USER_POINTER(chunk);
 }
@@ -927,7 +2236,7 @@ static void* realloc_chunk_and_before(void* ptr, size_int request) {
 
   remove_chunk_or_victim(prev_chunk);
   size_int old_size = CHUNK_SIZE(chunk);
-  memmove(CHUNK_TO_USER_POINTER(prev_chunk), ptr, old_size);
+  copy_payload(CHUNK_TO_USER_POINTER(prev_chunk), ptr, old_size);
   resize_chunk_and_split(prev_chunk, new_size, request);
   return CHUNK_TO_USER_POINTER(prev_chunk);
 }
@@ -945,7 +2254,7 @@ static void* realloc_chunk_before_and_after(void* ptr, size_int request) {
   remove_chunk_or_victim(next_chunk);
   remove_chunk_or_victim(prev_chunk);
   size_int old_size = CHUNK_SIZE(chunk);
-  memmove(CHUNK_TO_USER_POINTER(prev_chunk), ptr, old_size);
+  copy_payload(CHUNK_TO_USER_POINTER(prev_chunk), ptr, old_size);
   resize_chunk_and_split(prev_chunk, new_size, request);
   return CHUNK_TO_USER_POINTER(prev_chunk);
 }
@@ -958,55 +2267,512 @@ static void* realloc_chunk_after_extend_heap(void* ptr, size_int request) {
   chunk_t* next_chunk = NEXT_HEAP_CHUNK(chunk);
   size_int new_size = COMBINED_SIZES(chunk, next_chunk);
   if (request + SMALLEST_CHUNK > new_size) {
-    size_int difference = request + SMALLEST_CHUNK + EXTENSION_SIZE - new_size;
-    void* newptr = mem_sbrk(difference);
-    if (newptr == (void*) -1)
+    size_int difference = grow_heap(request + SMALLEST_CHUNK + EXTENSION_SIZE - new_size);
+    if (difference == 0)
       return NULL;
     next_chunk->current_size += difference;
     new_size += difference;
   }
-  END_OF_HEAP_BIN = NULL;
+  // The split off end is the new last chunk, so split_mallocd_chunk doesn't write past it.
+  END_OF_HEAP_BIN = (chunk_t*) ((char*) chunk + request + sizeof(size_int));
   chunk->current_size = new_size | IS_PREVIOUS_INUSE(chunk) | CURRENT_CHUNK_INUSE;
   chunk_t* splitted_chunk = split_mallocd_chunk(chunk, request);
+  assert(splitted_chunk == END_OF_HEAP_BIN);
   SET_PREVIOUS_INUSE(splitted_chunk);
-  END_OF_HEAP_BIN = splitted_chunk;
+  RAISE_CLEAN_HEAP_START();
   return CHUNK_TO_USER_POINTER(chunk);
 }
 
-static void* realloc_chunk_is_larger(void* ptr, size_int request) {
+#if REALLOC_HEADROOM
+// Pseudocode - Move the block into a chunk with headroom past the request, then split the
+// headroom off as the block's reserve. Falls back to a plain move if the bigger malloc
+// fails.
+static void* realloc_with_headroom(void* ptr, size_t size) {
+  size_int request = CHUNK_REQUEST(size);
+  size_int headroom = ALIGN(request >> REALLOC_HEADROOM_SHIFT);
+  // Straight from the chunks, since a slab object would be of the wrong class, and a
+  // chunk my_malloc counted would shrink away from the size it was counted under.
+  chunk_t* chunk = malloc_chunk(request + headroom);
+  if (chunk == NULL)
+    return default_realloc(ptr, size);
+  void* newptr = CHUNK_TO_USER_POINTER(chunk);
+  copy_payload(newptr, ptr, CHUNK_SIZE(USER_POINTER_TO_CHUNK(ptr)));
+  my_free(ptr);
+  STAT_ADD(realloc_headroom_moves, 1);
+  if (CAN_SPLIT_CHUNK(chunk, request))
+    reserve_headroom(split_mallocd_chunk(chunk, request));
+  return newptr;
+}
+
+// Pseudocode - If the chunk after the block is its reserve, grow the block into it and
+// keep what is left as the reserve. A reserve too small for the request is freed, so the
+// usual cases can coalesce it. Returns NULL if the block didn't grow.
+static void* realloc_into_headroom(void* ptr, size_int request) {
+  chunk_t* chunk = USER_POINTER_TO_CHUNK(ptr);
+  int slot = headroom_slot(NEXT_HEAP_CHUNK(chunk));
+  if (slot < 0)
+    return NULL;
+  chunk_t* reserve = headroom[slot];
+  size_int new_size = COMBINED_SIZES(chunk, reserve);
+  if (new_size < request) {
+    release_headroom(slot);
+    return NULL;
+  }
+  headroom[slot] = NULL;
+  headroom_count--;
+  chunk->current_size = new_size | IS_PREVIOUS_INUSE(chunk) | CURRENT_CHUNK_INUSE;
+  if (CAN_SPLIT_CHUNK(chunk, request))
+    reserve_headroom(split_mallocd_chunk(chunk, request));
+  return ptr;
+}
+
+// Returns the slot whose reserve chunk is, or -1 if it is no reserve.
+static int headroom_slot(chunk_t* chunk) {
+  for (int slot = 0; slot < REALLOC_HEADROOM_SLOTS; slot++)
+    if (headroom[slot] == chunk)
+      return slot;
+  return -1;
+}
+
+// Keeps a chunk just split off the end of a block in use, as the block's reserve. With
+// every slot taken, the biggest reserve is freed to make room.
+static void reserve_headroom(chunk_t* chunk) {
+  SET_CURRENT_INUSE(chunk);
+  int slot = headroom_slot(NULL);
+  if (slot < 0) {
+    slot = 0;
+    for (int s = 1; s < REALLOC_HEADROOM_SLOTS; s++)
+      if (CHUNK_SIZE(headroom[s]) > CHUNK_SIZE(headroom[slot]))
+        slot = s;
+    release_headroom(slot);
+  }
+  headroom[slot] = chunk;
+  headroom_count++;
+}
+
+static void release_headroom(int slot) {
+  chunk_t* reserve = headroom[slot];
+  headroom[slot] = NULL;
+  headroom_count--;
+  free_chunk(reserve);
+}
+
+// Pseudocode - For a malloc that would otherwise grow the heap, free the smallest reserve
+// with room for the request and take the request from the bins again.
+static chunk_t* headroom_malloc(size_int request) {
+  int best = -1;
+  for (int slot = 0; slot < REALLOC_HEADROOM_SLOTS; slot++) {
+    if (headroom[slot] != NULL && CHUNK_SIZE(headroom[slot]) >= request &&
+        (best < 0 || CHUNK_SIZE(headroom[slot]) < CHUNK_SIZE(headroom[best])))
+      best = slot;
+  }
+  if (best < 0)
+    return NULL;
+  release_headroom(best);
+  STAT_ADD(realloc_headroom_reclaimed, 1);
+  return IS_LARGE_SIZE(request) ? large_malloc(request) : small_malloc(request);
+}
+#endif
+
+// Flags the chunk realloc just grew, so that the next growth knows to leave headroom.
+static void* mark_realloc_grown(void* ptr) {
+  #if SLAB_ALLOCATOR
+  if (ptr == NULL || IS_SLAB_POINTER(ptr))
+    return ptr;
+  #else
+  if (ptr == NULL)
+    return ptr;
+  #endif
+  SET_REALLOC_GROWN(USER_POINTER_TO_CHUNK(ptr));
+  return ptr;
+}
+
+static void* realloc_chunk_is_larger(void* ptr, size_t size) {
+  size_int request = CHUNK_REQUEST(size);
   chunk_t* chunk = USER_POINTER_TO_CHUNK(ptr);
   void* result = NULL;
-  if (CAN_COMBINE_NEXT(chunk))
+  #if REALLOC_HEADROOM
+  if (headroom_count != 0 && !IS_END_OF_HEAP(NEXT_HEAP_CHUNK(chunk))) {
+    result = realloc_into_headroom(ptr, request);
+    if (result != NULL)
+      return result;
+  }
+  #endif
+  if (CAN_COMBINE_NEXT(chunk)) {
     result = realloc_chunk_and_after(ptr, request);
     if (result != NULL)
       return result;
-  if (CAN_COMBINE_PREVIOUS(chunk) && CAN_COMBINE_NEXT(chunk))
+  }
+  if (CAN_COMBINE_PREVIOUS(chunk) && CAN_COMBINE_NEXT(chunk)) {
     result = realloc_chunk_before_and_after(ptr, request);
     if (result != NULL)
       return result;
-  if (CAN_COMBINE_PREVIOUS(chunk) && !IS_END_OF_HEAP(NEXT_HEAP_CHUNK(chunk)))
+  }
+  // If the next chunk is free, the previous chunk alone is too small whenever the case above failed.
+  if (CAN_COMBINE_PREVIOUS(chunk) && !CAN_COMBINE_NEXT(chunk)) {
     result = realloc_chunk_and_before(ptr, request);
     if (result != NULL)
       return result;
+  }
   // Optionally add case here for better utilization
-  if (CAN_COMBINE_NEXT(chunk) && IS_END_OF_HEAP(NEXT_HEAP_CHUNK(chunk)))
+  if (CAN_COMBINE_NEXT(chunk) && IS_END_OF_HEAP(NEXT_HEAP_CHUNK(chunk))) {
     result = realloc_chunk_after_extend_heap(ptr, request); // should never return null
     if (result != NULL)
       return result;
+  }
+  #if REALLOC_HEADROOM
+  if (IS_REALLOC_GROWN(chunk))
+    return realloc_with_headroom(ptr, size);
+  #endif
   if (result == NULL)
-    result = default_realloc(ptr, request);
+    result = default_realloc(ptr, size);
   return result;
 }
 
 // realloc - Implemented simply in terms of malloc and free
 void * my_realloc(void *ptr, size_t size) {
-  size_int aligned_size = ALIGN(size);
-  size_int request = MAX(aligned_size, SMALLEST_MALLOC);
+  if (IS_TOO_LARGE_SIZE(size))
+    return NULL;
+  #if SLAB_ALLOCATOR
+  if (IS_SLAB_POINTER(ptr))
+    return slab_realloc(ptr, size);
+  #endif
+  #if SLAB_ALLOCATOR
+  forget_small_chunk(USER_POINTER_TO_CHUNK(ptr));
+  #endif
+  size_int request = CHUNK_REQUEST(size);
   size_int chunk_size = CHUNK_SIZE(USER_POINTER_TO_CHUNK(ptr));
   if (request <= chunk_size)
     return realloc_chunk_is_smaller(ptr, request);
+  return mark_realloc_grown(realloc_chunk_is_larger(ptr, size));
+}
+
+/* ------------------------------------------------------------------------- */
+// [START SLAB METHODS]
+#if SLAB_ALLOCATOR
+
+// Pseudocode - Take a page aligned run chunk from the heap, fill in the header for bin i
+// with every slot free, mark its page and push it on the bin's run list.
+static slab_t* new_slab_run(unsigned int list, bin_index i) {
+  chunk_t* chunk = aligned_malloc_chunk(SLAB_PAGE_SIZE, SLAB_RUN_CHUNK_SIZE);
+  if (chunk == NULL)
+    return NULL;
+  slab_t* run = CHUNK_TO_USER_POINTER(chunk);
+  assert(SLAB_RUN_OF(run) == run);
+  run->bin_number = i;
+  run->list = list;
+  run->object_size = i << 3;
+  run->capacity = SLAB_RUN_CAPACITY(run->object_size);
+  assert(run->capacity <= 64 * SLAB_MAP_WORDS);
+  run->free_count = run->capacity;
+  for (int w = 0; w < SLAB_MAP_WORDS; w++) {
+    int slots = run->capacity - 64 * w;
+    run->free_map[w] = (slots >= 64) ? ~0ULL : (slots > 0) ? (1ULL << slots) - 1 : 0;
+  }
+  MARK_SLAB_PAGE(run);
+  link_slab_run(run);
+  STAT_ADD(slab_runs, 1);
+  return run;
+}
+
+// Puts a run on its bin's list, which is kept in address order. Mallocs always take
+// the first run, so objects pack into the runs lowest in the heap and the higher ones
+// drain and get released.
+static void link_slab_run(slab_t* run) {
+  slab_t* prev = NULL;
+  slab_t* next = slab_runs[run->list][run->bin_number];
+  while (next != NULL && next < run) {
+    prev = next;
+    next = next->next;
+  }
+  run->prev = prev;
+  run->next = next;
+  if (prev != NULL)
+    prev->next = run;
   else
-    return realloc_chunk_is_larger(ptr, request);
+    slab_runs[run->list][run->bin_number] = run;
+  if (next != NULL)
+    next->prev = run;
+}
+
+// Unlinks an empty run from its bin's run list and frees its chunk.
+static void release_slab_run(slab_t* run) {
+  assert(run->free_count == run->capacity);
+  if (run->prev != NULL)
+    run->prev->next = run->next;
+  else
+    slab_runs[run->list][run->bin_number] = run->next;
+  if (run->next != NULL)
+    run->next->prev = run->prev;
+  CLEAR_SLAB_PAGE(run);
+  STAT_ADD(slab_runs_released, 1);
+  my_free(run);
+}
+
+// Pseudocode - A bin that has reached SLAB_MIN_REQUESTS stays there. Otherwise count
+// one more chunk for it and keep serving it from chunks.
+static bool is_busy_slab_class(size_int object_size) {
+  uint32_t* count = &slab_class_requests[small_request_index(object_size)];
+  if (*count >= SLAB_MIN_REQUESTS)
+    return true;
+  (*count)++;
+  return false;
+}
+
+// The object size a counted chunk goes back to when it is freed. Chunk sizes are rounded
+// up for the header, so align down.
+#define COUNTED_OBJECT_SIZE(chunk_ptr) \
+  MAX(CHUNK_SIZE(chunk_ptr) & ~(ALIGNMENT - 1), ALIGN(SLAB_SMALLEST_OBJECT))
+
+// Pseudocode - Mark the chunk my_malloc or my_malloc_hint just counted for object_size's
+// bin, so freeing it takes it off that count. A chunk that kept slack from a split would
+// go back to a bigger bin than it was counted in, so give its count back now instead.
+static void count_small_chunk(chunk_t* chunk, size_int object_size) {
+  if (COUNTED_OBJECT_SIZE(chunk) == object_size) {
+    SET_SLAB_COUNTED(chunk);
+  } else {
+    slab_class_requests[small_request_index(object_size)]--;
+  }
+}
+
+// Pseudocode - Take a counted chunk off the live count of its bin, unless the bin already
+// switched to slab runs. Other chunks (memalign, batches, regions, realloc'd blocks and
+// hinted classes without slab runs) were never counted.
+static void forget_small_chunk(chunk_t* chunk) {
+  if (!IS_SLAB_COUNTED(chunk))
+    return;
+  CLEAR_SLAB_COUNTED(chunk);
+  uint32_t* count = &slab_class_requests[small_request_index(COUNTED_OBJECT_SIZE(chunk))];
+  if (*count > 0 && *count < SLAB_MIN_REQUESTS)
+    (*count)--;
+}
+
+// Pseudocode - Take the first run of the bin (making one if there is none), pop its lowest
+// free slot, and drop the run off the list if that was its last free slot.
+static void* slab_malloc(unsigned int list, size_int request) {
+  bin_index i = small_request_index(request);
+  slab_t* run = slab_runs[list][i];
+  if (run == NULL) {
+    run = new_slab_run(list, i);
+    if (run == NULL)
+      return NULL;
+  }
+  assert(run->free_count > 0);
+  int w = 0;
+  while (run->free_map[w] == 0)
+    w++;
+  unsigned int slot = 64 * w + __builtin_ctzll(run->free_map[w]);
+  run->free_map[w] &= run->free_map[w] - 1;
+  if (--run->free_count == 0) {
+    slab_runs[list][i] = run->next;
+    if (run->next != NULL)
+      run->next->prev = NULL;
+    run->next = run->prev = NULL;
+  }
+  STAT_ADD(slab_mallocs, 1);
+  return SLAB_RUN_OBJECTS(run) + slot * run->object_size;
+}
+
+// Pseudocode - Set the object's bit in its run. A run that was full goes back on its bin's
+// list. A run that is now empty goes back to the heap, unless it is the only run the bin
+// has left, in which case it is kept around for the next malloc.
+static void slab_free(void* ptr) {
+  slab_t* run = SLAB_RUN_OF(ptr);
+  unsigned int slot = (ptr - SLAB_RUN_OBJECTS(run)) / run->object_size;
+  assert(SLAB_RUN_OBJECTS(run) + slot * run->object_size == ptr);
+  assert(slot < run->capacity && !((run->free_map[slot >> 6] >> (slot & 63)) & 1));
+  run->free_map[slot >> 6] |= 1ULL << (slot & 63);
+  if (run->free_count++ == 0) {
+    link_slab_run(run);
+  } else if (run->free_count == run->capacity && (run->next != NULL || run->prev != NULL)) {
+    release_slab_run(run);
+  }
+}
+
+// Slab objects can't change size in place, so a size in another class moves, which keeps
+// the object's class the one free_sized works out from the size. A shrink that can't
+// move stays put.
+static void* slab_realloc(void* ptr, size_t size) {
+  size_int object_size = SLAB_RUN_OF(ptr)->object_size;
+  if (MAX(ALIGN(size), ALIGN(SLAB_SMALLEST_OBJECT)) == object_size)
+    return ptr;
+  void* newptr = my_malloc(size);
+  if (newptr == NULL)
+    return (size < object_size) ? ptr : NULL;
+  copy_payload(newptr, ptr, MIN(size, object_size));
+  slab_free(ptr);
+  return newptr;
+}
+
+#endif
+// [END SLAB METHODS]
+/* ------------------------------------------------------------------------- */
+// [START REGION METHODS]
+// Objects malloc'd in a region can't be freed or realloc'd on their own. They all go away
+// when the region is reset or destroyed, which costs one free per block, not per object.
+
+region_t* my_region_create() {
+  region_t* region = my_malloc(sizeof(region_t));
+  if (region == NULL)
+    return NULL;
+  region_init(region);
+  return region;
+}
+
+static void region_init(region_t* region) {
+  region->blocks = NULL;
+  region->current = NULL;
+  region->cursor = NULL;
+  region->limit = NULL;
+  region->next_block_size = REGION_MIN_BLOCK_SIZE;
+}
+
+void* my_region_malloc(region_t* region, size_t size) {
+  if (size == 0 || IS_TOO_LARGE_SIZE(size))
+    return NULL;
+  size_t request = ALIGN(size);
+  if (request <= (size_t) (region->limit - region->cursor)) {
+    void* result = region->cursor;
+    region->cursor += request;
+    STAT_ADD(region_mallocs, 1);
+    return result;
+  }
+  return region_malloc_block(region, request);
+}
+
+// Pseudocode - A request that wouldn't fit in the next block, or that would take more
+// than a quarter of it, gets a block of its own, and the current block stays current.
+// Otherwise the next block becomes current, and the next one after it will be twice as big.
+static void* region_malloc_block(region_t* region, size_t request) {
+  bool own_block = request + REGION_BLOCK_HEADER_SIZE > region->next_block_size ||
+                   request > region->next_block_size / 4;
+  size_t block_size = own_block ? request + REGION_BLOCK_HEADER_SIZE : region->next_block_size;
+  struct region_block* block = my_malloc(block_size);
+  if (block == NULL)
+    return NULL;
+  block->next = region->blocks;
+  region->blocks = block;
+  char* result = (char*) block + REGION_BLOCK_HEADER_SIZE;
+  STAT_ADD(region_blocks, 1);
+  STAT_ADD(region_mallocs, 1);
+  if (own_block)
+    return result;
+  region->current = block;
+  region->cursor = result + request;
+  region->limit = (char*) block + my_malloc_usable_size(block);
+  if (region->next_block_size < REGION_BLOCK_SIZE)
+    region->next_block_size *= 2;
+  return result;
+}
+
+// Frees every block but the current one, which is kept for the next objects, since a
+// region is usually reset to be filled again.
+void my_region_reset(region_t* region) {
+  region_free_blocks(region, region->current);
+  region->blocks = region->current;
+  if (region->current != NULL) {
+    region->current->next = NULL;
+    region->cursor = (char*) region->current + REGION_BLOCK_HEADER_SIZE;
+  }
+}
+
+void my_region_destroy(region_t* region) {
+  region_free_blocks(region, NULL);
+  my_free(region);
+}
+
+static void region_free_blocks(region_t* region, struct region_block* keep) {
+  struct region_block* block = region->blocks;
+  while (block != NULL) {
+    struct region_block* next = block->next;
+    if (block != keep)
+      my_free(block);
+    block = next;
+  }
+}
+
+// [END REGION METHODS]
+/* ------------------------------------------------------------------------- */
+// [START POOL METHODS]
+// A pool is a region that also takes objects back one at a time. Objects of one size
+// never need a header to say how big they are, so a freed one only goes on the pool's
+// free list, and is handed out again before the region is bumped.
+
+pool_t* my_pool_create(size_t object_size) {
+  if (object_size == 0 || IS_TOO_LARGE_SIZE(object_size))
+    return NULL;
+  pool_t* pool = my_malloc(sizeof(pool_t));
+  if (pool == NULL)
+    return NULL;
+  region_init(&pool->region);
+  pool->free_objects = NULL;
+  pool->object_size = ALIGN(MAX(object_size, sizeof(struct pool_object)));
+  return pool;
+}
+
+void* my_pool_malloc(pool_t* pool) {
+  struct pool_object* object = pool->free_objects;
+  if (object != NULL) {
+    pool->free_objects = object->next;
+    STAT_ADD(pool_reuses, 1);
+    return object;
+  }
+  return my_region_malloc(&pool->region, pool->object_size);
+}
+
+void my_pool_free(pool_t* pool, void* ptr) {
+  if (ptr == NULL)
+    return;
+  struct pool_object* object = ptr;
+  object->next = pool->free_objects;
+  pool->free_objects = object;
+}
+
+// Frees every object in the pool, freed or not, with the blocks they live in.
+void my_pool_destroy(pool_t* pool) {
+  region_free_blocks(&pool->region, NULL);
+  my_free(pool);
+}
+
+// [END POOL METHODS]
+/* ------------------------------------------------------------------------- */
+
+// Prints what we know about the last run, for mdriver -s.
+void my_print_stats() {
+  #if LARGE_NODE_TABLE
+  printf("  large node table: %zu nodes (%zu bytes) at peak\n",
+         node_table_top, node_table_top * sizeof(bigchunk_t));
+  #endif
+  #ifdef STATS
+  #if SLAB_ALLOCATOR
+  printf("  slab: %lu mallocs, %lu runs made, %lu released\n",
+         stats.slab_mallocs, stats.slab_runs, stats.slab_runs_released);
+  #endif
+  #if FASTBINS
+  printf("  fastbin consolidations: %lu\n", stats.fastbin_consolidations);
+  #endif
+  printf("  unsorted bin: %lu hits, %lu chunks sorted\n", stats.unsorted_hits, stats.unsorted_sorted);
+  printf("  realloc moves with headroom: %lu, reserves reclaimed: %lu\n",
+         stats.realloc_headroom_moves, stats.realloc_headroom_reclaimed);
+  printf("  batches: %lu chunks carved together, %lu merged before freeing\n",
+         stats.batch_chunks_carved, stats.batch_chunks_merged);
+  printf("  regions: %lu mallocs, %lu blocks\n", stats.region_mallocs, stats.region_blocks);
+  printf("  pools: %lu mallocs of freed objects\n", stats.pool_reuses);
+  printf("  hints: short-lived %lu mallocs in %lu arenas, long-lived %lu in %lu, cold %lu in %lu\n",
+         stats.hint_mallocs[MALLOC_HINT_CLASS(MALLOC_HINT_SHORT_LIVED)],
+         stats.hint_arenas[MALLOC_HINT_CLASS(MALLOC_HINT_SHORT_LIVED)],
+         stats.hint_mallocs[MALLOC_HINT_CLASS(MALLOC_HINT_LONG_LIVED)],
+         stats.hint_arenas[MALLOC_HINT_CLASS(MALLOC_HINT_LONG_LIVED)],
+         stats.hint_mallocs[MALLOC_HINT_CLASS(MALLOC_HINT_COLD)],
+         stats.hint_arenas[MALLOC_HINT_CLASS(MALLOC_HINT_COLD)]);
+  printf("  calloc: %lu bytes zeroed, %lu known to be zero\n",
+         stats.calloc_bytes_zeroed, stats.calloc_bytes_clean);
+  printf("  large-bin tree walks: %lu, %.1f nodes/walk, %.0f cycles/walk\n", stats.tree_walks,
+         (double) stats.tree_walk_nodes / (stats.tree_walks ? stats.tree_walks : 1),
+         (double) stats.tree_walk_cycles / (stats.tree_walks ? stats.tree_walks : 1));
+  #else
+  printf("  (build with STATS=1 for operation counters)\n");
+  #endif
 }
 
 // call mem_reset_brk.
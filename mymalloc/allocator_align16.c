@@ -0,0 +1,48 @@
+// The allocator built with ALIGNMENT 16, linked into mdriver next to the default build so
+// that mdriver -a can validate it and report its utilization next to the 8 byte one.
+// This compiles allocator.c and my_checker.c once more with every external name given an
+// align16_ prefix. Builds that only want 16 byte alignment should just set ALIGNMENT.
+
+#undef ALIGNMENT
+#define ALIGNMENT 16
+
+#define my_init align16_init
+#define my_malloc align16_malloc
+#define my_realloc align16_realloc
+#define my_free align16_free
+#define my_free_sized align16_free_sized
+#define my_malloc_batch align16_malloc_batch
+#define my_free_batch align16_free_batch
+#define my_region_create align16_region_create
+#define my_region_malloc align16_region_malloc
+#define my_region_reset align16_region_reset
+#define my_region_destroy align16_region_destroy
+#define my_pool_create align16_pool_create
+#define my_pool_malloc align16_pool_malloc
+#define my_pool_free align16_pool_free
+#define my_pool_destroy align16_pool_destroy
+#define my_malloc_hint align16_malloc_hint
+#define my_memalign align16_memalign
+#define my_calloc align16_calloc
+#define my_malloc_usable_size align16_malloc_usable_size
+#define my_good_size align16_good_size
+#define my_malloc_at_least align16_malloc_at_least
+#define my_check align16_check
+#define my_reset_brk align16_reset_brk
+#define my_heap_lo align16_heap_lo
+#define my_heap_hi align16_heap_hi
+#define my_print_stats align16_print_stats
+#define chunk_link_base align16_chunk_link_base
+
+#define my_checker align16_checker
+#define is_circularly_linked_list align16_is_circularly_linked_list
+#define is_circularly_linked_node_list align16_is_circularly_linked_node_list
+#define is_valid_slab_run align16_is_valid_slab_run
+#define is_valid_chunk_pointer align16_is_valid_chunk_pointer
+#define chunk_not_in_tree align16_chunk_not_in_tree
+#define chunk_in_tree align16_chunk_in_tree
+#define is_valid_pointer_tree align16_is_valid_pointer_tree
+#define print_chunk_summary align16_print_chunk_summary
+
+#include "./allocator.c"
+#include "./my_checker.c"
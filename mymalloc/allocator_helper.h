@@ -4,6 +4,41 @@
 #ifndef _ALLOCATOR_STRUCTS_H
 #define _ALLOCATOR_STRUCTS_H
 
+// All blocks must have a specified minimum alignment.
+// The alignment requirement (from config.h) is >= 8 bytes. Set ALIGNMENT to 16 for the
+// alignment SSE types and long double need (what glibc guarantees). Chunk sizes then
+// keep their header plus the size a multiple of 16, so with 64-bit headers the chunk
+// classes are 24, 40, 56, ... and a block pays at most 15 bytes of padding.
+#ifndef ALIGNMENT
+#define ALIGNMENT 8
+#endif
+
+#if ALIGNMENT != 8 && ALIGNMENT != 16
+#error "ALIGNMENT must be 8 or 16"
+#endif
+
+// Set COMPACT_HEADERS to 1 to store chunk sizes in 32-bit fields. A chunk header is then
+// 8 bytes instead of 16, and an in-use chunk costs 4 bytes of overhead instead of 8.
+// Payloads stay 8-byte aligned: chunk sizes become 4 more than a multiple of 8, so
+// bit 2 belongs to the size and the unsorted and slab counted flags move up to bits 31
+// and 30. In exchange no chunk can be 2^30 bytes or larger, which the simulated heap
+// (MAX_HEAP) can't hold anyway. Use the default 64-bit headers for bigger heaps.
+#ifndef COMPACT_HEADERS
+#define COMPACT_HEADERS 0
+#endif
+
+#if COMPACT_HEADERS
+typedef uint32_t size_int;
+#define UNSORTED_CHUNK (1U << 31) // Free chunk waiting in the unsorted bin rather than its own bin
+#define SLAB_COUNTED (1U << 30)   // In-use chunk my_malloc counted toward slab runs
+#define SIZE_FLAG_BITS (3U | UNSORTED_CHUNK | SLAB_COUNTED)
+#else
+typedef uint64_t size_int;
+#define UNSORTED_CHUNK 4ULL // Free chunk waiting in the unsorted bin rather than its own bin
+#define SLAB_COUNTED (1ULL << 62) // In-use chunk my_malloc counted toward slab runs
+#define SIZE_FLAG_BITS (7ULL | SLAB_COUNTED)
+#endif
+
 #define CURRENT_CHUNK_INUSE 1ULL
 #define PREVIOUS_CHUNK_INUSE 2ULL
 
@@ -11,6 +46,20 @@
 #define IS_CURRENT_INUSE(chunk_ptr) (((chunk_ptr)->current_size) & CURRENT_CHUNK_INUSE)
 #define IS_PREVIOUS_FREE(chunk_ptr) (!IS_PREVIOUS_INUSE(chunk_ptr))
 #define IS_CURRENT_FREE(chunk_ptr) (!IS_CURRENT_INUSE(chunk_ptr))
+#define IS_UNSORTED(chunk_ptr) (((chunk_ptr)->current_size) & UNSORTED_CHUNK)
+
+// In-use chunks are never in the unsorted bin, so they reuse its bit to remember that
+// realloc has grown them before. free clears it again.
+#define REALLOC_GROWN UNSORTED_CHUNK
+#define IS_REALLOC_GROWN(chunk_ptr) (IS_CURRENT_INUSE(chunk_ptr) && IS_UNSORTED(chunk_ptr))
+#define SET_REALLOC_GROWN(chunk_ptr) (chunk_ptr)->current_size |= REALLOC_GROWN;
+#define CLEAR_REALLOC_GROWN(chunk_ptr) (chunk_ptr)->current_size &= ~REALLOC_GROWN;
+
+// A small chunk my_malloc counted toward its bin's switch to slab runs carries
+// SLAB_COUNTED until it is freed or realloc'd, so only those chunks come off the count.
+#define IS_SLAB_COUNTED(chunk_ptr) (((chunk_ptr)->current_size) & SLAB_COUNTED)
+#define SET_SLAB_COUNTED(chunk_ptr) (chunk_ptr)->current_size |= SLAB_COUNTED;
+#define CLEAR_SLAB_COUNTED(chunk_ptr) (chunk_ptr)->current_size &= ~SLAB_COUNTED;
 
 #define SET_PREVIOUS_INUSE(chunk_ptr) (chunk_ptr)->current_size |= PREVIOUS_CHUNK_INUSE;
 #define SET_CURRENT_INUSE(chunk_ptr) (chunk_ptr)->current_size |= CURRENT_CHUNK_INUSE;
@@ -18,15 +67,53 @@
 #define CLEAR_PREVIOUS_INUSE(chunk_ptr) (chunk_ptr)->current_size &= ~PREVIOUS_CHUNK_INUSE;
 #define CLEAR_CURRENT_INUSE(chunk_ptr) (chunk_ptr)->current_size &= ~CURRENT_CHUNK_INUSE;
 
-#define SAFE_SIZE(size) ((size) & ~7ULL)
+#define SAFE_SIZE(size) ((size) & ~SIZE_FLAG_BITS)
 #define CHUNK_SIZE(chunk_ptr) (SAFE_SIZE((chunk_ptr)->current_size))
 #define CHUNK_SIZES_EQUAL(chunk_ptr1, chunk_ptr2) (CHUNK_SIZE(chunk_ptr1) == CHUNK_SIZE(chunk_ptr2))
 
 #define FAST_LOG2(x) (sizeof(unsigned long long)*8 - 1 - __builtin_clzll((unsigned long long)(x)))
-typedef uint64_t size_int;
 
-#define SMALLEST_MALLOC (2*sizeof(struct small_chunk*)+sizeof(size_int))
+// Bins are picked by the chunk size rounded up to a multiple of 8. With 64-bit headers
+// that is the size itself. With compact headers it keeps the small bins at 24..248 and
+// makes the large bins (and the bits their trees branch on) start exactly at 256.
+#define BIN_KEY(size) (((size) + 7) & ~7ULL)
+
+// Set COMPRESSED_LINKS to 1 to store the next/prev links of free chunks as 32-bit byte
+// offsets instead of pointers. Offsets count from chunk_link_base, which my_init puts just
+// below mem_heap_lo() so that no chunk is at offset 0 and 0 can stand for NULL. Two links
+// then take 8 bytes instead of 16, so the smallest chunk shrinks to 24 bytes with 64-bit
+// headers and to 16 bytes with compact headers, and short strings and small nodes waste
+// less. The heap has to stay under 4GB, which MAX_HEAP guarantees.
+// Large chunks are always big enough for pointers, so the tree nodes keep them.
+#ifndef COMPRESSED_LINKS
+#define COMPRESSED_LINKS 0
+#endif
+
+struct small_chunk;
+#if COMPRESSED_LINKS
+typedef uint32_t chunk_link;
+extern char* chunk_link_base;
+#define CHUNK_LINK(chunk_ptr) \
+  ((chunk_link) ((chunk_ptr) == NULL ? 0 : (char*) (chunk_ptr) - chunk_link_base))
+#define LINKED_CHUNK(link) ((link) == 0 ? NULL : (struct small_chunk*) (chunk_link_base + (link)))
+#else
+typedef struct small_chunk* chunk_link;
+#define CHUNK_LINK(chunk_ptr) (chunk_ptr)
+#define LINKED_CHUNK(link) (link)
+#endif
+
+// The neighbours of a free chunk in its bin (or fastbin, or the unsorted bin).
+#define NEXT_FREE_CHUNK(chunk_ptr) LINKED_CHUNK((chunk_ptr)->next)
+#define PREV_FREE_CHUNK(chunk_ptr) LINKED_CHUNK((chunk_ptr)->prev)
+#define SET_NEXT_FREE_CHUNK(chunk_ptr, next_ptr) ((chunk_ptr)->next = CHUNK_LINK(next_ptr))
+#define SET_PREV_FREE_CHUNK(chunk_ptr, prev_ptr) ((chunk_ptr)->prev = CHUNK_LINK(prev_ptr))
+
+#define SMALLEST_MALLOC (2*sizeof(chunk_link)+sizeof(size_int))
 #define SMALLEST_CHUNK (SMALLEST_MALLOC + sizeof(size_int))
+// The smallest chunk size that keeps the next user pointer aligned. This is SMALLEST_MALLOC
+// except with ALIGNMENT 16 and compressed links or compact headers.
+#define SMALLEST_REQUEST \
+  (((SMALLEST_MALLOC + sizeof(size_int) + ALIGNMENT - 1) & ~(ALIGNMENT - 1)) - sizeof(size_int))
 
 #define USER_POINTER_TO_CHUNK(ptr) ((struct small_chunk*) (((uint64_t) (ptr)) - 2*sizeof(size_int)))
 #define CHUNK_TO_USER_POINTER(chunk_ptr) ((void*) chunk_ptr + 2*sizeof(size_int))
@@ -39,7 +126,9 @@ typedef uint64_t size_int;
 
 #define IS_END_OF_HEAP(chunk_ptr) ((chunk_ptr) == END_OF_HEAP_BIN)
 
-#define CIRCULAR_LIST_IS_LENGTH_ONE(chunk_ptr) ((chunk_ptr) == (chunk_ptr)->next && (chunk_ptr) == (chunk_ptr)->prev)
+#define CIRCULAR_LIST_IS_LENGTH_ONE(node_ptr) ((node_ptr) == (node_ptr)->next && (node_ptr) == (node_ptr)->prev)
+#define FREE_LIST_IS_LENGTH_ONE(chunk_ptr) \
+  ((chunk_ptr) == NEXT_FREE_CHUNK(chunk_ptr) && (chunk_ptr) == PREV_FREE_CHUNK(chunk_ptr))
 
 #define LARGE_CHUNK_CUTOFF 249
 // Anything 249 bytes or larger will go in the "large" bins
@@ -50,17 +139,20 @@ typedef uint64_t size_int;
 #define IS_SMALL_CHUNK(chunk_ptr) (!IS_LARGE_CHUNK(chunk_ptr))
 #define IS_SMALL_SIZE(size) (!IS_LARGE_SIZE(size))
 
-#define HUGE_CHUNK_CUTOFF 16777215
-// Anything larger than this goes in the huge bin
+#if COMPACT_HEADERS
+#define LARGEST_CHUNK_LOG2 29
+#else
+#define LARGEST_CHUNK_LOG2 46
+#endif
+// The large bins go up to 2^47 - 1 bytes (the size of a user address space on x86-64),
+// or 2^30 - 1 bytes with compact headers.
+// Anything larger than this can never be allocated. We leave a page of room below that
+// so rounding a request up can never push it past the last bin.
 
-#define IS_HUGE_CHUNK(chunk_ptr) (CHUNK_SIZE(chunk_ptr) > HUGE_CHUNK_CUTOFF)
-#define IS_HUGE_SIZE(size) ((size) > HUGE_CHUNK_CUTOFF)
+#define LARGEST_CHUNK_SIZE ((1ULL << (LARGEST_CHUNK_LOG2 + 1)) - 4096)
+#define IS_TOO_LARGE_SIZE(size) ((size) > LARGEST_CHUNK_SIZE)
 
 #define END_OF_HEAP_BIN (bins[0])
-#define VICTIM_BIN (bins[1])
-#define HUGE_BIN (bins[2])
-
-#define IS_VICTIM(chunk_ptr) ((chunk_ptr) == VICTIM_BIN)
 
 //size refers to the size of the chunk, not the malloc.
 struct small_chunk {
@@ -68,11 +160,47 @@ struct small_chunk {
   // Otherwise, currently being used by the previous chunk to store data;
 
   size_int current_size;// most significant 61 bits correspond to size, least significant 3 store information
-  // This next pointer is the start of usable memory for the malloc-caller.
-  struct small_chunk* next;
-  struct small_chunk* prev;
+                        // (with compact headers: bits 2-30 are the size, the rest are flags)
+  // This next link is the start of usable memory for the malloc-caller.
+  union {
+    struct {
+      chunk_link next;
+      chunk_link prev;
+    };
+    struct large_chunk* node; // Free large chunks with LARGE_NODE_TABLE: this chunk's tree node
+  };
+};
+
+// Large free chunks are kept in a bitwise trie per bin. Every trie function works on
+// a struct large_chunk "node": LARGE_NODE gets the node of a free large chunk, and
+// NODE_CHUNK gets the chunk back.
+//
+// By default the node is the chunk itself, so the tree fields live inside the free
+// chunk. Building with -DLARGE_NODE_TABLE=1 moves the nodes into a dense side table
+// instead: the free chunk only stores a pointer to its node (in place of its links), and
+// the node keeps a copy of the chunk size, so tree walks never touch the heap.
+#ifndef LARGE_NODE_TABLE
+#define LARGE_NODE_TABLE 0
+#endif
+
+#if LARGE_NODE_TABLE
+struct large_chunk {
+  // The fields used by tree walks come first, so a walk touches one cache line per node.
+  size_int size; // The size of the chunk this node describes.
+  size_int subtree_min;
+  struct large_chunk* children[2];
+  unsigned int shift;
+  unsigned int bin_number;
+  struct large_chunk* parent;
+  struct large_chunk* next;
+  struct large_chunk* prev;
+  struct small_chunk* chunk; // The free chunk this node describes.
 };
 
+#define LARGE_NODE(chunk_ptr) ((chunk_ptr)->node)
+#define NODE_CHUNK(node_ptr) ((node_ptr)->chunk)
+#define NODE_SIZE(node_ptr) ((node_ptr)->size)
+#else
 struct large_chunk {
   size_int previous_size;
   size_int current_size;
@@ -80,6 +208,8 @@ struct large_chunk {
   struct large_chunk* prev;
   struct large_chunk* children[2]; //Corresponds this chunk's children.
   struct large_chunk* parent; //Corresponds to the parent in the binary tree
+  size_int subtree_min; // The smallest chunk size anywhere in the subtree rooted at this node.
+                        // Only kept up to date for tree nodes, not for the rest of a node's linked list.
   unsigned int bin_number; // The bin this child is in
   unsigned int shift; // The shift we need to do to decide if we go left or right down this node
                       // For 256-511 (10D000000), this would be 6 since we need to shift 6 to the
@@ -88,13 +218,20 @@ struct large_chunk {
                       // Then, as you go down the tree, you subtract one.
 };
 
+#define LARGE_NODE(chunk_ptr) ((struct large_chunk*) (chunk_ptr))
+#define NODE_CHUNK(node_ptr) ((struct small_chunk*) (node_ptr))
+#define NODE_SIZE(node_ptr) CHUNK_SIZE(node_ptr)
+#endif
+
 #define NO_PARENT_CIRCLE_NODE NULL
 #define NO_PARENT_ROOT_NODE ((struct large_chunk*) 0x1)
 
-#define IS_VALID_LARGE_CHUNK(chunk_ptr) \
-  (IS_CURRENT_FREE(chunk_ptr) && (chunk_ptr)->next != NULL && (chunk_ptr)->prev != NULL \
-    && ((chunk_ptr)->parent == NO_PARENT_ROOT_NODE || (chunk_ptr)->parent == NO_PARENT_CIRCLE_NODE || \
-    ((chunk_ptr)->parent->children[(CHUNK_SIZE(chunk_ptr) >> (chunk_ptr)->parent->shift) & 1] == (chunk_ptr)) \
+// Takes the node of a large chunk.
+#define IS_VALID_LARGE_CHUNK(node_ptr) \
+  (IS_CURRENT_FREE(NODE_CHUNK(node_ptr)) && LARGE_NODE(NODE_CHUNK(node_ptr)) == (node_ptr) \
+    && (node_ptr)->next != NULL && (node_ptr)->prev != NULL \
+    && ((node_ptr)->parent == NO_PARENT_ROOT_NODE || (node_ptr)->parent == NO_PARENT_CIRCLE_NODE || \
+    ((node_ptr)->parent->children[(BIN_KEY(NODE_SIZE(node_ptr)) >> (node_ptr)->parent->shift) & 1] == (node_ptr)) \
     ))
 
 #define CONTAINS_TREE_LOOPS(chunk_ptr) \
@@ -104,9 +241,89 @@ struct large_chunk {
 
 
 #define IS_VALID_SMALL_CHUNK(chunk_ptr) \
-  (IS_CURRENT_FREE(chunk_ptr) && (chunk_ptr)->next != NULL && (chunk_ptr)->prev != NULL)
+  (IS_CURRENT_FREE(chunk_ptr) && NEXT_FREE_CHUNK(chunk_ptr) != NULL && PREV_FREE_CHUNK(chunk_ptr) != NULL)
+
+#define SUBTREE_MIN(chunk_ptr) (((chunk_ptr) == NULL) ? ~0ULL : (chunk_ptr)->subtree_min)
+
+// Small size classes that see a lot of requests are served from slab runs instead of
+// boundary-tagged chunks. A run is an ordinary in-use chunk whose user pointer is page
+// aligned and whose size stops just short of the next page, so the next chunk's size
+// field ends exactly on the page boundary and consecutive runs tile pages. The run
+// starts with this header and then holds objects of a single size class with no
+// per-object header.
+#ifndef SLAB_ALLOCATOR
+#define SLAB_ALLOCATOR 1
+#endif
+
+#define SLAB_PAGE_LOG2 12
+#define SLAB_PAGE_SIZE (1ULL << SLAB_PAGE_LOG2)
+#define SLAB_RUN_CHUNK_SIZE (SLAB_PAGE_SIZE - sizeof(size_int))
+// Slab classes start at the smallest chunk class: 24 bytes, or 16 with compressed links.
+#define SLAB_SMALLEST_OBJECT BIN_KEY(SMALLEST_MALLOC)
+#define SLAB_MAP_WORDS ((SLAB_PAGE_SIZE / SLAB_SMALLEST_OBJECT + 63) / 64)
+
+struct slab_run {
+  struct slab_run* next; // Runs of the same class that have a free slot. NULL terminated.
+  struct slab_run* prev;
+  uint16_t bin_number; // The small bin (size class) of every object in this run
+  uint16_t list;       // The slab_runs list the run is on: 0, or 1 + a hint class
+  uint32_t object_size;
+  uint32_t capacity;
+  uint32_t free_count;
+  uint64_t free_map[SLAB_MAP_WORDS]; // Bit i is set when slot i is free
+};
+
+// The objects start at the first aligned address after the run header.
+#define SLAB_RUN_HEADER_SIZE ((sizeof(struct slab_run) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+#define SLAB_RUN_OBJECTS(run_ptr) ((void*) (run_ptr) + SLAB_RUN_HEADER_SIZE)
+#define SLAB_RUN_CAPACITY(object_size) ((SLAB_RUN_CHUNK_SIZE - SLAB_RUN_HEADER_SIZE) / (object_size))
+#define SLAB_RUN_OF(ptr) ((struct slab_run*) (((uint64_t) (ptr)) & ~(SLAB_PAGE_SIZE - 1)))
+
+// A region bump allocates objects with no header out of blocks it takes from the heap with
+// my_malloc, and only gives them back all at once. The first block is
+// REGION_MIN_BLOCK_SIZE bytes, and each one after it is twice as big, up to
+// REGION_BLOCK_SIZE. Every block starts with a link to the block taken before it.
+#ifndef REGION_MIN_BLOCK_SIZE
+#define REGION_MIN_BLOCK_SIZE (4 << 10)
+#endif
+
+#ifndef REGION_BLOCK_SIZE
+#define REGION_BLOCK_SIZE (32 << 10)
+#endif
+
+struct region_block {
+  struct region_block* next;
+};
+
+struct region {
+  struct region_block* blocks;  // The newest block, NULL terminated
+  struct region_block* current; // The block being bumped through
+  char* cursor;                 // The current block's first free byte
+  char* limit;                  // The end of the current block
+  size_t next_block_size;
+};
+
+#define REGION_BLOCK_HEADER_SIZE ((sizeof(struct region_block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+// A pool hands out objects of one size, laid out back to back in its own region. A freed
+// object goes on the pool's free list, linked through its own first word, so objects have
+// no header and are at least a pointer big.
+struct pool_object {
+  struct pool_object* next;
+};
+
+struct pool {
+  struct region region;              // Where objects that were never freed come from
+  struct pool_object* free_objects;  // Freed objects, the last one freed first
+  size_t object_size;
+};
 
 typedef struct small_chunk chunk_t;
 typedef struct large_chunk bigchunk_t;
+typedef struct slab_run slab_t;
+
+// The first chunk of the heap: my_init puts it where its user pointer is aligned.
+#define FIRST_HEAP_CHUNK(heap_lo) ((chunk_t*) \
+  ((((uint64_t) (heap_lo) + 2*sizeof(size_int) + ALIGNMENT - 1) & ~(uint64_t) (ALIGNMENT - 1)) - 2*sizeof(size_int)))
 
 #endif  // _ALLOCATOR_STRUCTS_H
@@ -30,6 +30,23 @@
  * single validator to operate on both libc malloc, a buggy malloc, and the
  * student "mm" malloc.
  */
+// The packages that support regions and pools each define their structs their own way.
+typedef struct region region_t;
+typedef struct pool pool_t;
+
+// Flags for malloc_hint, saying how a block will be used
+#define MALLOC_HINT_SHORT_LIVED 1 // freed soon, like the temporaries of one request
+#define MALLOC_HINT_LONG_LIVED 2  // kept for most of the run, like an index node
+#define MALLOC_HINT_COLD 4        // rarely touched once written
+
+// The hint class malloc_hint files a block under: 0 for no flags, then short-lived,
+// long-lived and cold. Cold wins whatever the lifetime, and short-lived wins over
+// long-lived.
+#define MALLOC_HINT_CLASSES 4
+#define MALLOC_HINT_CLASS(flags) (((flags) & MALLOC_HINT_COLD) ? 3 : \
+                                  ((flags) & MALLOC_HINT_SHORT_LIVED) ? 1 : \
+                                  ((flags) & MALLOC_HINT_LONG_LIVED) ? 2 : 0)
+
 typedef struct {
   int (*init)(void);
   void *(*malloc)(size_t size);
@@ -39,12 +56,45 @@ typedef struct {
   void (*reset_brk)(void);
   void *(*heap_lo)(void);
   void *(*heap_hi)(void);
+  void (*print_stats)(void); // Optional: prints statistics about the last run
+  void *(*memalign)(size_t alignment, size_t size); // Optional: aligned malloc
+  void *(*calloc)(size_t nmemb, size_t size); // Optional: zeroed malloc
+  size_t (*usable_size)(void *ptr); // Optional: bytes the block can hold
+  size_t (*good_size)(size_t size); // Optional: usable bytes a malloc of size gets at least
+  void (*free_sized)(void *ptr, size_t size); // Optional: free given the block's size
+  size_t (*malloc_batch)(size_t size, size_t n, void **out); // Optional: n mallocs at once
+  void (*free_batch)(void **ptrs, size_t n); // Optional: n frees at once, may overwrite ptrs
+  region_t *(*region_create)(void); // Optional, with the next three: objects freed together
+  void *(*region_malloc)(region_t *region, size_t size);
+  void (*region_reset)(region_t *region); // frees every object in the region
+  void (*region_destroy)(region_t *region);
+  pool_t *(*pool_create)(size_t object_size); // Optional, with the next three: objects of one size
+  void *(*pool_malloc)(pool_t *pool);
+  void (*pool_free)(pool_t *pool, void *ptr);
+  void (*pool_destroy)(pool_t *pool); // frees every object in the pool
+  void *(*malloc_hint)(size_t size, int flags); // Optional: malloc with MALLOC_HINT_ flags
+  size_t alignment; // Optional: the payload alignment to validate, if above R_ALIGNMENT
 } malloc_impl_t;
 
 int libc_init();
 void * libc_malloc(size_t size);
 void * libc_realloc(void *ptr, size_t size);
 void libc_free(void *ptr);
+void * libc_memalign(size_t alignment, size_t size);
+void * libc_calloc(size_t nmemb, size_t size);
+size_t libc_malloc_usable_size(void *ptr);
+void libc_free_sized(void *ptr, size_t size);
+size_t libc_malloc_batch(size_t size, size_t n, void **out);
+void libc_free_batch(void **ptrs, size_t n);
+region_t * libc_region_create();
+void * libc_region_malloc(region_t *region, size_t size);
+void libc_region_reset(region_t *region);
+void libc_region_destroy(region_t *region);
+pool_t * libc_pool_create(size_t object_size);
+void * libc_pool_malloc(pool_t *pool);
+void libc_pool_free(pool_t *pool, void *ptr);
+void libc_pool_destroy(pool_t *pool);
+void * libc_malloc_hint(size_t size, int flags);
 int libc_check();
 void libc_reset_brk();
 void * libc_heap_lo();
@@ -53,21 +103,97 @@ void * libc_heap_hi();
 static const malloc_impl_t libc_impl =
 { .init = &libc_init, .malloc = &libc_malloc, .realloc = &libc_realloc,
   .free = &libc_free, .check = &libc_check, .reset_brk = &libc_reset_brk,
-  .heap_lo = &libc_heap_lo, .heap_hi = &libc_heap_hi};
+  .heap_lo = &libc_heap_lo, .heap_hi = &libc_heap_hi, .memalign = &libc_memalign,
+  .calloc = &libc_calloc, .usable_size = &libc_malloc_usable_size,
+  .free_sized = &libc_free_sized, .malloc_batch = &libc_malloc_batch,
+  .free_batch = &libc_free_batch, .region_create = &libc_region_create,
+  .region_malloc = &libc_region_malloc, .region_reset = &libc_region_reset,
+  .region_destroy = &libc_region_destroy, .pool_create = &libc_pool_create,
+  .pool_malloc = &libc_pool_malloc, .pool_free = &libc_pool_free,
+  .pool_destroy = &libc_pool_destroy, .malloc_hint = &libc_malloc_hint};
 
 int my_init();
 void * my_malloc(size_t size);
 void * my_realloc(void *ptr, size_t size);
 void my_free(void *ptr);
+void * my_memalign(size_t alignment, size_t size);
+void * my_calloc(size_t nmemb, size_t size);
+size_t my_malloc_usable_size(void *ptr);
+size_t my_good_size(size_t size);
+void * my_malloc_at_least(size_t size, size_t *usable_size);
+void my_free_sized(void *ptr, size_t size);
+size_t my_malloc_batch(size_t size, size_t n, void **out);
+void my_free_batch(void **ptrs, size_t n);
+region_t * my_region_create();
+void * my_region_malloc(region_t *region, size_t size);
+void my_region_reset(region_t *region);
+void my_region_destroy(region_t *region);
+pool_t * my_pool_create(size_t object_size);
+void * my_pool_malloc(pool_t *pool);
+void my_pool_free(pool_t *pool, void *ptr);
+void my_pool_destroy(pool_t *pool);
+void * my_malloc_hint(size_t size, int flags);
 int my_check();
 void my_reset_brk();
 void * my_heap_lo();
 void * my_heap_hi();
+void my_print_stats();
 
 static const malloc_impl_t my_impl =
 { .init = &my_init, .malloc = &my_malloc, .realloc = &my_realloc,
   .free = &my_free, .check = &my_check, .reset_brk = &my_reset_brk,
-  .heap_lo = &my_heap_lo, .heap_hi = &my_heap_hi};
+  .heap_lo = &my_heap_lo, .heap_hi = &my_heap_hi,
+  .print_stats = &my_print_stats, .memalign = &my_memalign, .calloc = &my_calloc,
+  .usable_size = &my_malloc_usable_size, .good_size = &my_good_size,
+  .free_sized = &my_free_sized,
+  .malloc_batch = &my_malloc_batch, .free_batch = &my_free_batch,
+  .region_create = &my_region_create, .region_malloc = &my_region_malloc,
+  .region_reset = &my_region_reset, .region_destroy = &my_region_destroy,
+  .pool_create = &my_pool_create, .pool_malloc = &my_pool_malloc,
+  .pool_free = &my_pool_free, .pool_destroy = &my_pool_destroy,
+  .malloc_hint = &my_malloc_hint};
+
+int align16_init();
+void * align16_malloc(size_t size);
+void * align16_realloc(void *ptr, size_t size);
+void align16_free(void *ptr);
+void * align16_memalign(size_t alignment, size_t size);
+void * align16_calloc(size_t nmemb, size_t size);
+size_t align16_malloc_usable_size(void *ptr);
+size_t align16_good_size(size_t size);
+void * align16_malloc_at_least(size_t size, size_t *usable_size);
+void align16_free_sized(void *ptr, size_t size);
+size_t align16_malloc_batch(size_t size, size_t n, void **out);
+void align16_free_batch(void **ptrs, size_t n);
+region_t * align16_region_create();
+void * align16_region_malloc(region_t *region, size_t size);
+void align16_region_reset(region_t *region);
+void align16_region_destroy(region_t *region);
+pool_t * align16_pool_create(size_t object_size);
+void * align16_pool_malloc(pool_t *pool);
+void align16_pool_free(pool_t *pool, void *ptr);
+void align16_pool_destroy(pool_t *pool);
+void * align16_malloc_hint(size_t size, int flags);
+int align16_check();
+void align16_reset_brk();
+void * align16_heap_lo();
+void * align16_heap_hi();
+void align16_print_stats();
+
+// The same allocator built with ALIGNMENT 16 (allocator_align16.c)
+static const malloc_impl_t align16_impl =
+{ .init = &align16_init, .malloc = &align16_malloc, .realloc = &align16_realloc,
+  .free = &align16_free, .check = &align16_check, .reset_brk = &align16_reset_brk,
+  .heap_lo = &align16_heap_lo, .heap_hi = &align16_heap_hi,
+  .print_stats = &align16_print_stats, .memalign = &align16_memalign,
+  .calloc = &align16_calloc, .usable_size = &align16_malloc_usable_size,
+  .good_size = &align16_good_size, .free_sized = &align16_free_sized,
+  .malloc_batch = &align16_malloc_batch, .free_batch = &align16_free_batch, .region_create = &align16_region_create,
+  .region_malloc = &align16_region_malloc, .region_reset = &align16_region_reset,
+  .region_destroy = &align16_region_destroy, .pool_create = &align16_pool_create,
+  .pool_malloc = &align16_pool_malloc, .pool_free = &align16_pool_free,
+  .pool_destroy = &align16_pool_destroy, .malloc_hint = &align16_malloc_hint,
+  .alignment = 16};
 
 int bad_init();
 void * bad_malloc(size_t size);
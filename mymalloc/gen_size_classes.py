@@ -0,0 +1,161 @@
+#!/usr/bin/env python
+#
+# Generates size_classes.h, the lookup table that maps large chunk sizes to bins.
+#
+# Every doubling [2^l, 2^(l+1)) of the large sizes is split into 2^k equal classes, with
+# k between 0 and SIZE_CLASS_BITS, and each class is one bin (one trie of free chunks).
+# By default k is picked per doubling from the requests in the given trace directories.
+# Every doubling starts as a single class. Then, while there are bins left, the doubling
+# whose next split saves the most rounding waste per extra bin is split again. Rounding
+# waste is the distance from a request to the top of its class, summed over every
+# request. --uniform K gives every doubling K classes instead.
+#
+# usage: ./gen_size_classes.py [--uniform K] [--max-bins N] [-o size_classes.h] [trace dirs]
+from __future__ import print_function
+import argparse
+import os
+import sys
+
+SMALL_BINS = 32          # Bins 0-31 are the special and small bins
+FIRST_LARGE_LOG2 = 8     # The large bins start at 256 bytes
+LAST_LARGE_LOG2 = 46     # LARGEST_CHUNK_LOG2 with 64-bit headers
+SIZE_CLASS_BITS = 3      # At most 8 classes per doubling
+LARGE_CHUNK_CUTOFF = 249
+SMALLEST_MALLOC = 24
+
+
+def bin_key(size):
+  # The bin key of the chunk a malloc of size bytes gets (see CHUNK_REQUEST and BIN_KEY).
+  return max((size + 7) & ~7, SMALLEST_MALLOC)
+
+
+def read_requests(directories):
+  counts = {}
+  for directory in directories:
+    for name in sorted(os.listdir(directory)):
+      with open(os.path.join(directory, name)) as trace:
+        for line in trace:
+          fields = line.split()
+          if len(fields) == 3 and fields[0] in ('a', 'r'):
+            key = bin_key(int(fields[2]))
+            if key >= LARGE_CHUNK_CUTOFF:
+              counts[key] = counts.get(key, 0) + 1
+  return counts
+
+
+def rounding_waste(requests, l, k):
+  width = 1 << (l - k)
+  waste = 0
+  for key, count in requests:
+    top = (key - (1 << l)) // width * width + (1 << l) + width - 8
+    waste += (top - key) * count
+  return waste
+
+
+def pick_class_bits(counts, max_large_bins):
+  doublings = range(FIRST_LARGE_LOG2, LAST_LARGE_LOG2 + 1)
+  per_doubling = dict((l, []) for l in doublings)
+  for key, count in counts.items():
+    per_doubling[key.bit_length() - 1].append((key, count))
+  bits = dict((l, 0) for l in doublings)
+  bins_left = max_large_bins - len(bits)
+  while True:
+    best = None
+    for l in doublings:
+      k = bits[l]
+      if k == SIZE_CLASS_BITS or (1 << k) > bins_left:
+        continue
+      saved = rounding_waste(per_doubling[l], l, k) - rounding_waste(per_doubling[l], l, k + 1)
+      if saved > 0 and (best is None or saved * best[1] > best[0] * (1 << k)):
+        best = (saved, 1 << k, l)
+    if best is None:
+      return bits
+    bins_left -= best[1]
+    bits[best[2]] += 1
+
+
+def write_header(out, bits, sources):
+  table = []
+  shifts = []
+  ranges = []
+  n = SMALL_BINS
+  for l in range(FIRST_LARGE_LOG2, LAST_LARGE_LOG2 + 1):
+    k = bits[l]
+    for top in range(1 << SIZE_CLASS_BITS):
+      table.append(n + (top >> (SIZE_CLASS_BITS - k)))
+    for c in range(1 << k):
+      shifts.append(l - k - 1)
+    # One comment line per run of doublings with the same number of classes
+    if ranges and ranges[-1][2] == k:
+      ranges[-1][1] = l
+      ranges[-1][4] = n + (1 << k) - 1
+    else:
+      ranges.append([l, l, k, n, n + (1 << k) - 1])
+    n += 1 << k
+  ranges = ['// 2^%d - 2^%d bytes: %d per doubling (bins %d - %d)' % (first, last + 1, 1 << k, low, high)
+            for first, last, k, low, high in ranges]
+
+  def rows(values):
+    lines = []
+    for i in range(0, len(values), 16):
+      lines.append('  ' + ', '.join('%d' % v for v in values[i:i + 16]) + ',')
+    return '\n'.join(lines)
+
+  out.write('''// Generated by gen_size_classes.py %s
+// Don't edit this by hand, rerun the generator (make size_classes) instead.
+#ifndef _SIZE_CLASSES_H
+#define _SIZE_CLASSES_H
+
+#include <stdint.h>
+
+// Each doubling of the large sizes is split into up to 2^SIZE_CLASS_BITS bins:
+%s
+#define SIZE_CLASS_BITS %d
+#define FIRST_LARGE_LOG2 %d
+#define NUM_OF_LARGE_BINS %d
+
+// The bin of a large bin key with log2 l, indexed by l - FIRST_LARGE_LOG2 and then the
+// SIZE_CLASS_BITS bits below the leading one.
+static const uint8_t large_bin_table[%d] = {
+%s
+};
+
+// The shift of the root of each large bin's trie, by bin - 32: the highest bit that can
+// differ between two sizes in the same bin.
+static const uint8_t large_bin_shift[NUM_OF_LARGE_BINS] = {
+%s
+};
+
+#endif  // _SIZE_CLASSES_H
+''' % (sources, '\n'.join(ranges), SIZE_CLASS_BITS, FIRST_LARGE_LOG2, n - SMALL_BINS,
+       len(table), rows(table), rows(shifts)))
+
+
+def main():
+  parser = argparse.ArgumentParser(description='Generate the large size class table.')
+  parser.add_argument('traces', nargs='*', default=['traces', 'additional_traces'])
+  parser.add_argument('--uniform', type=int, choices=[1, 2, 4, 8],
+                      help='split every doubling into this many classes')
+  parser.add_argument('--max-bins', type=int, default=128,
+                      help='total bins, special and small ones included')
+  parser.add_argument('-o', '--output', default='size_classes.h')
+  args = parser.parse_args()
+
+  max_large_bins = args.max_bins - SMALL_BINS
+  doublings = range(FIRST_LARGE_LOG2, LAST_LARGE_LOG2 + 1)
+  if args.uniform is not None:
+    bits = dict((l, args.uniform.bit_length() - 1) for l in doublings)
+    sources = 'with --uniform %d' % args.uniform
+  else:
+    bits = pick_class_bits(read_requests(args.traces), max_large_bins)
+    sources = 'from ' + ' '.join(args.traces)
+  large_bins = sum(1 << k for k in bits.values())
+  if large_bins > max_large_bins:
+    sys.exit('size classes %s need %d large bins, but --max-bins only leaves %d'
+             % (sources, large_bins, max_large_bins))
+  with open(args.output, 'w') as out:
+    write_header(out, bits, sources)
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,375 @@
+#!/usr/bin/env python3
+#
+# Generates the synthetic trace directories for the calls the course traces don't use.
+# Each directory is one workload, written by the function of the same name below. The
+# workloads are seeded, so rerunning one rewrites its traces byte for byte (with Python
+# 3's random module). Traces named *plain* or *no* replay the same requests through
+# plain malloc and free, for mdriver to compare against.
+#
+# realloc_traces/trace_c9_v0 and trace_c9_v1 are links to the course's c9 traces, not
+# generated here.
+#
+# usage: ./gen_traces.py [directory ...]    (default: every directory)
+import argparse
+import os
+import random
+import sys
+
+
+def trace(ids, ops):
+  # The trace file format: heap size hint, number of ids, number of ops, weight, ops.
+  return '0\n%d\n%d\n1\n' % (ids, len(ops)) + '\n'.join(ops) + '\n'
+
+
+def realloc_traces():
+  traces = {}
+  # Two buffers grown alternately to 6MB, with a pinned allocation behind each step.
+  ops = ['a 0 65536', 'a 1 65536']
+  ids = 2
+  size = 65536
+  while size < 6 << 20:
+    size += 65536
+    for b in (0, 1):
+      ops.append('r %d %d' % (b, size))
+      ops.append('a %d 512' % ids)
+      ids += 1
+  ops += ['f %d' % i for i in range(ids)]
+  traces['trace_grow_v0'] = trace(ids, ops)
+  # A free block before each big block, so growing it slides it down
+  # (realloc_chunk_and_before).
+  ops = []
+  ids = 0
+  for i in range(40):
+    a, b, p = ids, ids + 1, ids + 2
+    ids += 3
+    ops += ['a %d %d' % (a, 2 << 20), 'a %d %d' % (b, 2 << 20), 'a %d 64' % p,
+            'f %d' % a, 'r %d %d' % (b, 3 << 20), 'f %d' % b]
+  # Blocks from memmove sizes up to streaming ones sliding down by less than their own
+  # size, so source and destination overlap. The pins are too big for the slab runs, so
+  # they sit right after the blocks.
+  for size in (300, 3000, 100000, 5 << 20):
+    for before in (300, 1000, 4000):
+      a, b, p = ids, ids + 1, ids + 2
+      ids += 3
+      ops += ['a %d %d' % (a, before), 'a %d %d' % (b, size), 'a %d 1000' % p,
+              'f %d' % a, 'r %d %d' % (b, size + before // 2), 'f %d' % b]
+  ops += ['f %d' % (i * 3 + 2) for i in range(ids // 3)]
+  traces['trace_slide_v0'] = trace(ids, ops)
+  return traces
+
+
+def memalign_traces():
+  traces = {}
+  # Plain mallocs mixed with aligned requests of every size, some reallocated later.
+  rnd = random.Random(18)
+  ops, live, ids = [], [], 0
+  for step in range(6000):
+    r = rnd.random()
+    if live and r < 0.4:
+      ops.append('f %d' % live.pop(rnd.randrange(len(live))))
+    elif live and r < 0.45:
+      ops.append('r %d %d' % (rnd.choice(live), rnd.randint(1, 6000)))
+    else:
+      size = rnd.choice([rnd.randint(1, 256), rnd.randint(256, 6000)])
+      if r < 0.75:
+        ops.append('m %d %d %d' % (ids, size, rnd.choice([16, 32, 64, 256, 4096])))
+      else:
+        ops.append('a %d %d' % (ids, size))
+      live.append(ids)
+      ids += 1
+  ops += ['f %d' % i for i in live]
+  traces['trace_memalign_v0'] = trace(ids, ops)
+  # Cache line aligned buffers, as for per-thread counters kept off each other's lines.
+  rnd = random.Random(19)
+  ops, live, ids = [], [], 0
+  for step in range(6000):
+    if live and rnd.random() < 0.45:
+      ops.append('f %d' % live.pop(rnd.randrange(len(live))))
+    else:
+      ops.append('m %d %d 64' % (ids, rnd.choice([8, 24, 64, 100, 192])))
+      live.append(ids)
+      ids += 1
+  ops += ['f %d' % i for i in live]
+  traces['trace_cacheline_v0'] = trace(ids, ops)
+  return traces
+
+
+def calloc_traces():
+  traces = {}
+  # Callocs mixed with mallocs, reallocs and frees, so most callocs reuse dirty memory.
+  rnd = random.Random(19)
+  ops, live, ids = [], [], 0
+  for step in range(8000):
+    r = rnd.random()
+    if live and r < 0.42:
+      ops.append('f %d' % live.pop(rnd.randrange(len(live))))
+    elif live and r < 0.47:
+      ops.append('r %d %d' % (rnd.choice(live), rnd.randint(1, 8000)))
+    else:
+      size = rnd.choice([rnd.randint(1, 128), rnd.randint(128, 1024), rnd.randint(1024, 16384)])
+      ops.append('%s %d %d' % ('c' if r < 0.75 else 'a', ids, size))
+      live.append(ids)
+      ids += 1
+  ops += ['f %d' % i for i in live]
+  traces['trace_calloc_v0'] = trace(ids, ops)
+  # Large zeroed buffers, such as hash tables and matrices, that mostly come from fresh
+  # heap.
+  rnd = random.Random(20)
+  ops, live, ids = [], [], 0
+  for step in range(600):
+    if len(live) > 6 and rnd.random() < 0.35:
+      ops.append('f %d' % live.pop(rnd.randrange(len(live))))
+    else:
+      size = rnd.choice([rnd.randint(1, 64), rnd.randint(4096, 65536), rnd.randint(65536, 1 << 20)])
+      ops.append('%s %d %d' % ('c' if size > 64 else 'a', ids, size))
+      live.append(ids)
+      ids += 1
+  ops += ['f %d' % i for i in live]
+  traces['trace_calloc_big_v0'] = trace(ids, ops)
+  return traces
+
+
+def batch_rounds(seed, batch, rounds=300):
+  # Rounds of same-size objects, batched or one at a time. A tenth of each round is
+  # reallocated and three quarters of its second half freed right away. The first half
+  # and the rest are freed together once more than three rounds are alive.
+  rnd = random.Random(seed)
+  ops = []
+  ids = 0
+  live = []
+  sizes = [16, 24, 40, 64, 100, 200, 300, 500, 1000, 4000]
+  def free(base, count, rest):
+    if batch:
+      ops.append('F %d %d' % (base, count))
+    else:
+      ops.extend('f %d' % (base + j) for j in range(count))
+    ops.extend('f %d' % i for i in rest)
+  for r in range(rounds):
+    k = rnd.randint(8, 200)
+    s = rnd.choice(sizes)
+    base = ids
+    ids += k
+    if batch:
+      ops.append('A %d %d %d' % (base, k, s))
+    else:
+      ops.extend('a %d %d' % (base + j, s) for j in range(k))
+    half = k // 2
+    for j in rnd.sample(range(k), k // 10):
+      ops.append('r %d %d' % (base + j, s + rnd.randint(1, 2 * s)))
+    tail = list(range(base + half, base + k))
+    rnd.shuffle(tail)
+    ops.extend('f %d' % i for i in tail[:len(tail) * 3 // 4])
+    live.append((base, half, tail[len(tail) * 3 // 4:]))
+    if len(live) > 3:
+      free(*live.pop(rnd.randrange(len(live))))
+  for round_ in live:
+    free(*round_)
+  return trace(ids, ops)
+
+
+def batch_nodes(seed, batch, rounds=400):
+  # Whole structures built and torn down at once: every id is freed by the batch it was
+  # allocated with, and up to 8 structures are alive at a time.
+  rnd = random.Random(seed)
+  ops = []
+  ids = 0
+  live = []
+  sizes = [32, 48, 96, 256, 320, 512, 768, 2048]
+  def free(base, count):
+    if batch:
+      ops.append('F %d %d' % (base, count))
+    else:
+      ops.extend('f %d' % (base + j) for j in range(count))
+  for r in range(rounds):
+    k = rnd.randint(16, 256)
+    s = rnd.choice(sizes)
+    base = ids
+    ids += k
+    if batch:
+      ops.append('A %d %d %d' % (base, k, s))
+    else:
+      ops.extend('a %d %d' % (base + j, s) for j in range(k))
+    live.append((base, k))
+    if len(live) > 8:
+      free(*live.pop(rnd.randrange(len(live))))
+  for base, count in live:
+    free(base, count)
+  return trace(ids, ops)
+
+
+def batch_traces():
+  return {'trace_batch_v0': batch_rounds(1, True),
+          'trace_nobatch_v0': batch_rounds(1, False),
+          'trace_nodes_v0': batch_nodes(2, True),
+          'trace_nodes_nobatch_v0': batch_nodes(2, False)}
+
+
+def region_requests(seed, regions, requests=40):
+  # Request-scoped work: up to 4 requests in flight, each with its own region, allocating
+  # objects that all die when the request ends. Some long-lived objects come and go too.
+  rnd = random.Random(seed)
+  ops = []
+  ids = 0
+  cache = []
+  slots = {}  # region -> (ids of the request, objects left to allocate)
+  def size():
+    r = rnd.random()
+    if r < 0.7:
+      return rnd.randint(8, 128)
+    if r < 0.95:
+      return rnd.randint(128, 1024)
+    return rnd.randint(1024, 16384)
+  if regions:
+    ops.extend('g %d' % r for r in range(4))
+  started = 0
+  while started < requests or slots:
+    free = [r for r in range(4) if r not in slots]
+    if free and started < requests and rnd.random() < 0.3:
+      slots[rnd.choice(free)] = ([], rnd.randint(50, 2000))
+      started += 1
+      continue
+    if not slots:
+      continue
+    r = rnd.choice(list(slots))
+    mine, left = slots[r]
+    for _ in range(min(left, rnd.randint(1, 40))):
+      s = size()
+      ops.append(('n %d %d %d' % (r, ids, s)) if regions else ('a %d %d' % (ids, s)))
+      mine.append(ids)
+      ids += 1
+      left -= 1
+    if rnd.random() < 0.05:
+      ops.append('a %d %d' % (ids, rnd.randint(16, 2048)))
+      cache.append(ids)
+      ids += 1
+      if len(cache) > 200:
+        ops.append('f %d' % cache.pop(rnd.randrange(len(cache))))
+    if left == 0:
+      if regions:
+        ops.append('x %d' % r)
+      else:
+        ops.extend('f %d' % i for i in mine)
+      del slots[r]
+    else:
+      slots[r] = (mine, left)
+  if regions:
+    ops.extend('d %d' % r for r in range(4))
+  ops.extend('f %d' % i for i in cache)
+  return trace(ids, ops)
+
+
+def region_traces():
+  return {'trace_region_v0': region_requests(1, True),
+          'trace_region_plain_v0': region_requests(1, False)}
+
+
+def pool_nodes(seed, pools, steps=60000):
+  # Node-heavy work: three kinds of fixed-size nodes (a tree, a list and a hash chain)
+  # inserted and deleted at random, with variable-size strings malloc'd and freed among
+  # them.
+  rnd = random.Random(seed)
+  kinds = [24, 48, 72]
+  ops = []
+  ids = 0
+  live = [[] for _ in kinds]
+  strings = []
+  if pools:
+    ops.extend('p %d %d' % (k, s) for k, s in enumerate(kinds))
+  for step in range(steps):
+    k = rnd.randrange(len(kinds))
+    target = 3000 + 2000 * k
+    r = rnd.random()
+    if r < 0.08:
+      ops.append('a %d %d' % (ids, rnd.randint(16, 600)))
+      strings.append(ids)
+      ids += 1
+      if len(strings) > 800:
+        ops.append('f %d' % strings.pop(rnd.randrange(len(strings))))
+    elif len(live[k]) < target * (0.5 + rnd.random()):
+      ops.append(('o %d %d' % (k, ids)) if pools else ('a %d %d' % (ids, kinds[k])))
+      live[k].append(ids)
+      ids += 1
+    else:
+      j = live[k].pop(rnd.randrange(len(live[k])))
+      ops.append(('q %d %d' % (k, j)) if pools else ('f %d' % j))
+  for k in range(len(kinds)):
+    if pools:
+      ops.append('e %d' % k)
+    else:
+      ops.extend('f %d' % j for j in live[k])
+  ops.extend('f %d' % j for j in strings)
+  return trace(ids, ops)
+
+
+def pool_traces():
+  return {'trace_pool_v0': pool_nodes(1, True),
+          'trace_pool_plain_v0': pool_nodes(1, False)}
+
+
+def hint_server(seed, hints, requests=3000):
+  # A server building a long-lived index while serving requests. Each request mallocs
+  # short-lived temporaries that die when it ends, and now and then adds an index node
+  # (long-lived) with a cold record hanging off it. Old index entries are retired slowly.
+  rnd = random.Random(seed)
+  ops = []
+  ids = [0]
+  index = []
+  def malloc(size, flags):
+    ops.append(('h %d %d %d' % (ids[0], size, flags)) if hints else ('a %d %d' % (ids[0], size)))
+    ids[0] += 1
+    return ids[0] - 1
+  inflight = []
+  for r in range(requests):
+    temps = [malloc(rnd.choice([rnd.randint(16, 128), rnd.randint(128, 1024)]), 1)
+             for _ in range(rnd.randint(2, 12))]
+    inflight.append(temps)
+    if rnd.random() < 0.6:
+      index.append((malloc(rnd.randint(32, 96), 2), malloc(rnd.randint(64, 512), 4)))
+    if len(index) > 400 and rnd.random() < 0.25:
+      node, cold = index.pop(rnd.randrange(len(index)))
+      ops.append('f %d' % node)
+      ops.append('f %d' % cold)
+    if len(inflight) > 4 or rnd.random() < 0.5:
+      ops.extend('f %d' % t for t in inflight.pop(rnd.randrange(len(inflight))))
+  for temps in inflight:
+    ops.extend('f %d' % t for t in temps)
+  for node, cold in index:
+    ops.append('f %d' % node)
+    ops.append('f %d' % cold)
+  return trace(ids[0], ops)
+
+
+def hint_traces():
+  return {'trace_hint_v0': hint_server(1, True),
+          'trace_hint_plain_v0': hint_server(1, False)}
+
+
+WORKLOADS = [realloc_traces, memalign_traces, calloc_traces, batch_traces, region_traces,
+             pool_traces, hint_traces]
+
+
+def main():
+  names = [w.__name__ for w in WORKLOADS]
+  parser = argparse.ArgumentParser(description='Generate the synthetic trace directories.')
+  parser.add_argument('directories', nargs='*', default=names, metavar='directory',
+                      help=', '.join(names))
+  args = parser.parse_args()
+  for name in args.directories:
+    if name not in names:
+      parser.error('no workload %s (choose from %s)' % (name, ', '.join(names)))
+
+  root = os.path.dirname(os.path.abspath(__file__))
+  for workload in WORKLOADS:
+    if workload.__name__ not in args.directories:
+      continue
+    directory = os.path.join(root, workload.__name__)
+    if not os.path.isdir(directory):
+      os.mkdir(directory)
+    for name, text in sorted(workload().items()):
+      with open(os.path.join(directory, name), 'w') as out:
+        out.write(text)
+      print('wrote %s/%s' % (workload.__name__, name), file=sys.stderr)
+
+
+if __name__ == '__main__':
+  main()
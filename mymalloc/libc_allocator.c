@@ -20,6 +20,8 @@
  * IN THE SOFTWARE.
  **/
 
+#include <malloc.h>
+
 #include "./allocator_interface.h"
 
 /* Libc needs no initialization. */
@@ -61,3 +63,140 @@ void * libc_realloc(void *ptr, size_t size) {
 void libc_free(void *ptr) {
   free(ptr);
 }
+
+/*call default posix_memalign */
+void * libc_memalign(size_t alignment, size_t size) {
+  void *ptr;
+  if (posix_memalign(&ptr, alignment, size) != 0)
+    return NULL;
+  return ptr;
+}
+
+/*call default calloc */
+void * libc_calloc(size_t nmemb, size_t size) {
+  return calloc(nmemb, size);
+}
+
+/*call default malloc_usable_size */
+size_t libc_malloc_usable_size(void *ptr) {
+  return malloc_usable_size(ptr);
+}
+
+/*libc has no use for the size, call default free */
+void libc_free_sized(void *ptr, size_t size) {
+  free(ptr);
+}
+
+/*libc has no batch malloc, call default malloc n times */
+size_t libc_malloc_batch(size_t size, size_t n, void **out) {
+  size_t done = 0;
+  while (done < n && (out[done] = malloc(size)) != NULL)
+    done++;
+  return done;
+}
+
+/*libc has no batch free, call default free n times */
+void libc_free_batch(void **ptrs, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    free(ptrs[i]);
+}
+
+/*libc has no regions, so a region keeps a list of default mallocs to free one by one */
+struct region {
+  struct region_object *objects;
+};
+
+struct region_object {
+  struct region_object *next;
+  struct region_object *unused; /* keeps the payload 16 byte aligned */
+  char payload[];
+};
+
+region_t * libc_region_create() {
+  region_t *region = malloc(sizeof(region_t));
+  if (region != NULL)
+    region->objects = NULL;
+  return region;
+}
+
+void * libc_region_malloc(region_t *region, size_t size) {
+  struct region_object *object = malloc(sizeof(struct region_object) + size);
+  if (object == NULL)
+    return NULL;
+  object->next = region->objects;
+  region->objects = object;
+  return object->payload;
+}
+
+void libc_region_reset(region_t *region) {
+  while (region->objects != NULL) {
+    struct region_object *next = region->objects->next;
+    free(region->objects);
+    region->objects = next;
+  }
+}
+
+void libc_region_destroy(region_t *region) {
+  libc_region_reset(region);
+  free(region);
+}
+
+/*libc has no pools either, so a pool keeps a list of its live default mallocs */
+struct pool {
+  struct pool_object *objects;
+  size_t object_size;
+};
+
+struct pool_object {
+  struct pool_object *next;
+  struct pool_object *prev;
+  char payload[];
+};
+
+pool_t * libc_pool_create(size_t object_size) {
+  pool_t *pool = malloc(sizeof(pool_t));
+  if (pool != NULL) {
+    pool->objects = NULL;
+    pool->object_size = object_size;
+  }
+  return pool;
+}
+
+void * libc_pool_malloc(pool_t *pool) {
+  struct pool_object *object = malloc(sizeof(struct pool_object) + pool->object_size);
+  if (object == NULL)
+    return NULL;
+  object->next = pool->objects;
+  object->prev = NULL;
+  if (pool->objects != NULL)
+    pool->objects->prev = object;
+  pool->objects = object;
+  return object->payload;
+}
+
+void libc_pool_free(pool_t *pool, void *ptr) {
+  if (ptr == NULL)
+    return;
+  struct pool_object *object = (struct pool_object *) ((char *) ptr - sizeof(struct pool_object));
+  if (object->prev != NULL)
+    object->prev->next = object->next;
+  else
+    pool->objects = object->next;
+  if (object->next != NULL)
+    object->next->prev = object->prev;
+  free(object);
+}
+
+void libc_pool_destroy(pool_t *pool) {
+  while (pool->objects != NULL) {
+    struct pool_object *next = pool->objects->next;
+    free(pool->objects);
+    pool->objects = next;
+  }
+  free(pool);
+}
+
+/*libc takes no hints, call default malloc */
+void * libc_malloc_hint(size_t size, int flags) {
+  return malloc(size);
+}
@@ -30,15 +30,38 @@ typedef struct {
 
   /* defined only for the student malloc package */
   double util;     /* space utilization for this trace (always 0 for libc) */
+  double sbrks;    /* mem_sbrk calls during the utilization run (always 0 for libc) */
+  double sized_secs; /* secs to run the trace freeing with free_sized (-z only) */
 
   /* Note: secs and util are only defined if valid is true */
 } stats_t;
 
+/* What the live blocks of one hint class touch, summed over the samples of a
+ * utilization run (-p). The fewer blocks of other classes share a class's cache lines
+ * and pages, the more of those lines and pages its own bytes fill. The span runs from
+ * the class's lowest live byte to its highest, and the holes in it are what no live
+ * block of any class covers: free chunks and headers. */
+typedef struct {
+  double bytes;    /* payload bytes of the class's live blocks */
+  double lines;    /* cache lines those blocks touch */
+  double pages;    /* pages those blocks touch */
+  double span;     /* bytes from the class's first live block to the end of its last */
+  double holes;    /* bytes in the span no live block covers */
+} placement_t;
+
+#define PLACEMENT_SAMPLES 16 /* points of a utilization run that -p samples */
+#define LINE_SHIFT 6         /* 64 byte cache lines */
+#define PAGE_SHIFT 12        /* 4K pages */
+
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
+int free_sized = 0;     /* global flag for timing and checking impl->free_sized */
 static int errors = 0;  /* number of errs found when running student malloc */
+static int report_placement = 0; /* sample where each hint class's blocks sit (-p) */
+static placement_t placement[MALLOC_HINT_CLASSES]; /* ... in the last utilization run */
+static int placement_samples = 0; /* ... at this many points */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
 /* Directory where default tracefiles are found */
@@ -61,12 +84,22 @@ static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace);
 static void eval_my_speed(trace_t *trace) {
   eval_mm_speed(&my_impl, trace);
 }
+static void eval_my_sized_speed(trace_t *trace) {
+  free_sized = 1;
+  eval_mm_speed(&my_impl, trace);
+  free_sized = 0;
+}
 static void eval_libc_speed(trace_t *trace) {
   eval_mm_speed(&libc_impl, trace);
 }
+static void eval_align16_speed(trace_t *trace) {
+  eval_mm_speed(&align16_impl, trace);
+}
 static int eval_mm_check(const malloc_impl_t *impl, trace_t *trace, int tracenum);
 
 /* Various helper routines */
+static void sample_placement(trace_t *trace);
+static void printplacement(void);
 static void printresults(int n, char **tracefiles, stats_t *stats);
 static void usage(void);
 
@@ -85,10 +118,15 @@ int main(int argc, char **argv) {
   stats_t *libc_stats = NULL;/* libc stats for each trace */
   stats_t *bad_stats = NULL; /* bad malloc stats for each trace */
   stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
+  stats_t *align16_stats = NULL; /* mm stats with 16 byte alignment for each trace */
 
   int run_bad = 0;     /* If set, run bad malloc (set by -b) */
   int check_heap = 0;  /* If set, run the student heap checker (set by -c) */
   int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+  int print_stats = 0; /* If set, print the mm package's statistics (-s) */
+  int run_align16 = 0; /* If set, also run mm built for 16 byte alignment (-a) */
+  int run_sized = 0;   /* If set, also time mm freeing with free_sized (-z) */
+  /* report_placement is a global, since eval_mm_util does the sampling (-p) */
 
   /* temporaries used to compute the performance index */
   double total_throughput, total_util, average_util, average_throughput, p1, p2, perfindex;
@@ -97,7 +135,7 @@ int main(int argc, char **argv) {
   /*
    * Read and interpret the command line arguments
    */
-  while ((c = getopt(argc, argv, "f:t:hvVgcb")) != EOF) {
+  while ((c = getopt(argc, argv, "f:t:hvVgcbsazp")) != EOF) {
     switch (c) {
       case 'g': /* Generate summary info for the autograder */
         autograder = 1;
@@ -123,6 +161,18 @@ int main(int argc, char **argv) {
       case 'c':
         check_heap = 1;
         break;
+      case 's': /* Print allocator statistics for each trace */
+        print_stats = 1;
+        break;
+      case 'a': /* Also run the mm package built for 16 byte alignment */
+        run_align16 = 1;
+        break;
+      case 'z': /* Also time the mm package freeing with the block's size */
+        run_sized = 1;
+        break;
+      case 'p': /* Report where the mm package puts each hint class */
+        report_placement = 1;
+        break;
       case 'v': /* Print per-trace performance breakdown */
         verbose = 1;
         break;
@@ -261,6 +311,10 @@ int main(int argc, char **argv) {
     unix_error("mm_stats calloc in main failed");
   }
 
+  /* Check that good_size never promises more than a malloc gives */
+  if (!eval_good_size(&my_impl))
+    errors++;
+
   /* Evaluate student's mm malloc package using the K-best scheme */
   for (i = 0; i < num_tracefiles; i++) {
     trace = read_trace(tracedir, tracefiles[i]);
@@ -269,6 +323,11 @@ int main(int argc, char **argv) {
       printf("Checking mm_malloc for correctness, ");
     }
     mm_stats[i].valid = eval_mm_valid(&my_impl, trace, i);
+    if (run_sized && mm_stats[i].valid) {
+      free_sized = 1;
+      mm_stats[i].valid = eval_mm_valid(&my_impl, trace, i);
+      free_sized = 0;
+    }
     if (check_heap) {
       mm_stats[i].checked = eval_mm_check(&my_impl, trace, i);
     }
@@ -277,14 +336,58 @@ int main(int argc, char **argv) {
         printf("efficiency, ");
       }
       mm_stats[i].util = eval_mm_util(&my_impl, trace, i);
+      mm_stats[i].sbrks = mem_sbrk_count();
+      if (print_stats && my_impl.print_stats != NULL) {
+        printf("Statistics for %s after the utilization run\n", tracefiles[i]);
+        my_impl.print_stats();
+      }
+      if (report_placement) {
+        printf("Placement for %s during the utilization run\n", tracefiles[i]);
+        printplacement();
+      }
       if (verbose > 1) {
         printf("and performance.\n");
       }
       mm_stats[i].secs = fsecs((void (*)(void *))eval_my_speed, trace);
+      if (run_sized) {
+        mm_stats[i].sized_secs = fsecs((void (*)(void *))eval_my_sized_speed, trace);
+      }
     }
     free_trace(trace);
   }
 
+  /*
+   * Optionally run and evaluate the mm package built for 16 byte alignment
+   */
+  if (run_align16) {
+    if (verbose > 1) {
+      printf("\nTesting mm malloc with 16 byte alignment\n");
+    }
+
+    align16_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
+    if (align16_stats == NULL) {
+      unix_error("align16_stats calloc in main failed");
+    }
+
+    if (!eval_good_size(&align16_impl))
+      errors++;
+
+    for (i = 0; i < num_tracefiles; i++) {
+      trace = read_trace(tracedir, tracefiles[i]);
+      align16_stats[i].ops = trace->num_ops;
+      align16_stats[i].valid = eval_mm_valid(&align16_impl, trace, i);
+      if (check_heap) {
+        align16_stats[i].checked = eval_mm_check(&align16_impl, trace, i);
+      }
+      if (align16_stats[i].valid) {
+        align16_stats[i].util = eval_mm_util(&align16_impl, trace, i);
+        align16_stats[i].sbrks = mem_sbrk_count();
+        align16_stats[i].secs = fsecs((void (*)(void *))eval_align16_speed, trace);
+      }
+      free_trace(trace);
+    }
+  }
+
   /* Free the simulated heap block. */
   mem_deinit();
 
@@ -293,6 +396,11 @@ int main(int argc, char **argv) {
     printf("\nResults for mm malloc:\n");
     printresults(num_tracefiles, tracefiles, mm_stats);
     printf("\n");
+    if (run_align16) {
+      printf("Results for mm malloc with 16 byte alignment:\n");
+      printresults(num_tracefiles, tracefiles, align16_stats);
+      printf("\n");
+    }
   }
 
   /*
@@ -340,6 +448,50 @@ int main(int argc, char **argv) {
 
   printf("# %f (util)  +  %f (tput)  =  %f\n", p1, p2, perfindex);
 
+  /*
+   * The 16 byte aligned build is only reported, it doesn't count towards the index
+   */
+  if (run_align16) {
+    double total_util16 = 0;
+    if (verbose) {
+      printf("(util)%24s%8s%8s\n", "filename", "8 byte", "16 byte");
+    }
+    for (i = 0; i < num_tracefiles; i++) {
+      if (align16_stats[i].valid) {
+        total_util16 += align16_stats[i].util;
+        if (verbose) {
+          printf("%30s%7.0f%%%7.0f%%\n", tracefiles[i],
+                 mm_stats[i].util*100, align16_stats[i].util*100);
+        }
+      }
+    }
+    printf("# 16 byte alignment: %f%% util, against %f%% with 8 byte alignment\n",
+           100.0 * total_util16/num_tracefiles, 100.0 * average_util);
+  }
+
+  /*
+   * Sized frees are only reported too, as the throughput of the whole trace
+   */
+  if (run_sized) {
+    double ops = 0, secs = 0, sized_secs = 0;
+    if (verbose) {
+      printf("(Kops)%24s%8s%8s\n", "filename", "free", "sized");
+    }
+    for (i = 0; i < num_tracefiles; i++) {
+      if (mm_stats[i].valid) {
+        ops += mm_stats[i].ops;
+        secs += mm_stats[i].secs;
+        sized_secs += mm_stats[i].sized_secs;
+        if (verbose) {
+          printf("%30s%8.0f%8.0f\n", tracefiles[i], mm_stats[i].ops / mm_stats[i].secs / 1000,
+                 mm_stats[i].ops / mm_stats[i].sized_secs / 1000);
+        }
+      }
+    }
+    printf("# sized free: %.0f Kops, against %.0f Kops with free\n",
+           ops / sized_secs / 1000, ops / secs / 1000);
+  }
+
   if (autograder) {
     printf("correct:%d\n", numcorrect);
     printf("perfidx:%f\n", perfindex);
@@ -353,6 +505,7 @@ int main(int argc, char **argv) {
   free(libc_stats);
   free(bad_stats);
   free(mm_stats);
+  free(align16_stats);
 
   for (i = 0; i < num_tracefiles; i++) {
     free(tracefiles[i]);
@@ -379,7 +532,10 @@ static trace_t *read_trace(char *tracedir, char *filename) {
   trace_t *trace;
   char type[MAXLINE];
   char path[MAXLINE];
-  unsigned index, size;
+  unsigned index, size, alignment, count, region, pool, hint;
+  size_t region_bytes[MAXREGIONS] = {0}; /* bytes malloc'd in each region since its reset */
+  size_t pool_sizes[MAXPOOLS] = {0};     /* object size of each pool */
+  size_t pool_bytes[MAXPOOLS] = {0};     /* bytes live in each pool */
   unsigned max_index = 0;
   unsigned op_index;
 
@@ -422,6 +578,28 @@ static trace_t *read_trace(char *tracedir, char *filename) {
     unix_error("malloc 4 failed in read_trace");
   }
 
+  /* Until the trace runs, block_sizes holds the latest size asked for each id, which is
+   * the size a sized free of that id passes */
+  memset(trace->block_sizes, 0, trace->num_ids * sizeof(size_t));
+
+  /* ... and the region of each id that is malloc'd in one */
+  if ((trace->block_regions = (int *)malloc(trace->num_ids * sizeof(int))) == NULL) {
+    unix_error("malloc 5 failed in read_trace");
+  }
+  memset(trace->block_regions, -1, trace->num_ids * sizeof(int));
+
+  /* ... or the pool */
+  if ((trace->block_pools = (int *)malloc(trace->num_ids * sizeof(int))) == NULL) {
+    unix_error("malloc 6 failed in read_trace");
+  }
+  memset(trace->block_pools, -1, trace->num_ids * sizeof(int));
+
+  /* ... and the hint class of each id */
+  if ((trace->block_hints = (int *)malloc(trace->num_ids * sizeof(int))) == NULL) {
+    unix_error("malloc 7 failed in read_trace");
+  }
+  memset(trace->block_hints, 0, trace->num_ids * sizeof(int));
+
   /* read every request line in the trace file */
   index = 0;
   op_index = 0;
@@ -432,6 +610,7 @@ static trace_t *read_trace(char *tracedir, char *filename) {
         trace->ops[op_index].type = ALLOC;
         trace->ops[op_index].index = index;
         trace->ops[op_index].size = size;
+        trace->block_sizes[index] = size;
         max_index = (index > max_index) ? index : max_index;
         break;
       case 'r':
@@ -439,12 +618,128 @@ static trace_t *read_trace(char *tracedir, char *filename) {
         trace->ops[op_index].type = REALLOC;
         trace->ops[op_index].index = index;
         trace->ops[op_index].size = size;
+        trace->block_sizes[index] = size;
+        max_index = (index > max_index) ? index : max_index;
+        break;
+      case 'm':
+        fscanf(tracefile, "%u %u %u", &index, &size, &alignment);
+        trace->ops[op_index].type = MEMALIGN;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].size = size;
+        trace->block_sizes[index] = size;
+        trace->ops[op_index].alignment = alignment;
+        max_index = (index > max_index) ? index : max_index;
+        break;
+      case 'c':
+        fscanf(tracefile, "%u %u", &index, &size);
+        trace->ops[op_index].type = CALLOC;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].size = size;
+        trace->block_sizes[index] = size;
+        max_index = (index > max_index) ? index : max_index;
+        break;
+      case 'h': /* malloc with hint flags */
+        fscanf(tracefile, "%u %u %u", &index, &size, &hint);
+        trace->ops[op_index].type = ALLOC_HINT;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].size = size;
+        trace->ops[op_index].hint = hint;
+        trace->block_sizes[index] = size;
+        trace->block_hints[index] = MALLOC_HINT_CLASS(hint);
+        max_index = (index > max_index) ? index : max_index;
+        break;
+      case 'A': /* batch malloc of ids index to index + count - 1 */
+        fscanf(tracefile, "%u %u %u", &index, &count, &size);
+        trace->ops[op_index].type = BATCH_ALLOC;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].count = count;
+        trace->ops[op_index].size = size;
+        for (unsigned id = index; id < index + count; id++)
+          trace->block_sizes[id] = size;
+        max_index = (index + count - 1 > max_index) ? index + count - 1 : max_index;
+        break;
+      case 'F': /* batch free of ids index to index + count - 1 */
+        fscanf(tracefile, "%u %u", &index, &count);
+        trace->ops[op_index].type = BATCH_FREE;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].count = count;
+        break;
+      case 'g': /* create region */
+      case 'x': /* reset region */
+      case 'd': /* destroy region */
+        fscanf(tracefile, "%u", &region);
+        if (region >= MAXREGIONS) {
+          snprintf(msg, sizeof(msg), "Region %u in %s is over MAXREGIONS", region, filename);
+          app_error(msg);
+        }
+        trace->ops[op_index].type = (type[0] == 'g') ? REGION_CREATE :
+                                    (type[0] == 'x') ? REGION_RESET : REGION_DESTROY;
+        trace->ops[op_index].region = region;
+        /* what a reset or destroy frees, for the utilization */
+        trace->ops[op_index].size = region_bytes[region];
+        region_bytes[region] = 0;
+        break;
+      case 'n': /* malloc in a region */
+        fscanf(tracefile, "%u %u %u", &region, &index, &size);
+        if (region >= MAXREGIONS) {
+          snprintf(msg, sizeof(msg), "Region %u in %s is over MAXREGIONS", region, filename);
+          app_error(msg);
+        }
+        trace->ops[op_index].type = REGION_ALLOC;
+        trace->ops[op_index].region = region;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].size = size;
+        trace->block_regions[index] = region;
+        region_bytes[region] += size;
+        max_index = (index > max_index) ? index : max_index;
+        break;
+      case 'p': /* create pool */
+        fscanf(tracefile, "%u %u", &pool, &size);
+        if (pool >= MAXPOOLS) {
+          snprintf(msg, sizeof(msg), "Pool %u in %s is over MAXPOOLS", pool, filename);
+          app_error(msg);
+        }
+        trace->ops[op_index].type = POOL_CREATE;
+        trace->ops[op_index].pool = pool;
+        trace->ops[op_index].size = size;
+        pool_sizes[pool] = size;
+        break;
+      case 'o': /* malloc in a pool */
+      case 'q': /* free to a pool */
+        fscanf(tracefile, "%u %u", &pool, &index);
+        if (pool >= MAXPOOLS) {
+          snprintf(msg, sizeof(msg), "Pool %u in %s is over MAXPOOLS", pool, filename);
+          app_error(msg);
+        }
+        trace->ops[op_index].type = (type[0] == 'o') ? POOL_ALLOC : POOL_FREE;
+        trace->ops[op_index].pool = pool;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].size = pool_sizes[pool];
+        if (type[0] == 'o') {
+          trace->block_pools[index] = pool;
+          pool_bytes[pool] += pool_sizes[pool];
+        } else {
+          pool_bytes[pool] -= pool_sizes[pool];
+        }
         max_index = (index > max_index) ? index : max_index;
         break;
+      case 'e': /* destroy pool */
+        fscanf(tracefile, "%u", &pool);
+        if (pool >= MAXPOOLS) {
+          snprintf(msg, sizeof(msg), "Pool %u in %s is over MAXPOOLS", pool, filename);
+          app_error(msg);
+        }
+        trace->ops[op_index].type = POOL_DESTROY;
+        trace->ops[op_index].pool = pool;
+        /* what a destroy frees, for the utilization */
+        trace->ops[op_index].size = pool_bytes[pool];
+        pool_bytes[pool] = 0;
+        break;
       case 'f':
         fscanf(tracefile, "%ud", &index);
         trace->ops[op_index].type = FREE;
         trace->ops[op_index].index = index;
+        trace->ops[op_index].size = trace->block_sizes[index]; /* for free_sized */
         break;
       case 'w':
         fscanf(tracefile, "%u %u", &index, &size);
@@ -474,6 +769,9 @@ void free_trace(trace_t *trace) {
   free(trace->ops);         /* free the three arrays... */
   free(trace->blocks);
   free(trace->block_sizes);
+  free(trace->block_regions);
+  free(trace->block_pools);
+  free(trace->block_hints);
   free(trace);              /* and the trace record itself... */
 }
 
@@ -507,13 +805,32 @@ static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracen
     app_error("init failed in eval_mm_util");
   }
 
+  /* blocks are NULL while their ids aren't live, for sample_placement */
+  memset(trace->blocks, 0, trace->num_ids * sizeof(char *));
+  memset(placement, 0, sizeof(placement));
+  placement_samples = 0;
+  int sample_interval = trace->num_ops / PLACEMENT_SAMPLES + 1;
+
   for (i = 0; i < trace->num_ops; i++) {
+    if (report_placement && i % sample_interval == 0)
+      sample_placement(trace);
     switch (trace->ops[i].type) {
       case ALLOC: /* alloc */
+      case MEMALIGN: /* memalign */
+      case CALLOC: /* calloc */
+      case ALLOC_HINT: /* malloc with hints */
         index = trace->ops[i].index;
         size = trace->ops[i].size;
 
-        if ((p = (char *) impl->malloc(size)) == NULL) {
+        if (trace->ops[i].type == MEMALIGN)
+          p = (char *) impl->memalign(trace->ops[i].alignment, size);
+        else if (trace->ops[i].type == CALLOC)
+          p = (char *) impl->calloc(1, size);
+        else if (trace->ops[i].type == ALLOC_HINT)
+          p = (char *) impl->malloc_hint(size, trace->ops[i].hint);
+        else
+          p = (char *) impl->malloc(size);
+        if (p == NULL) {
           app_error("malloc failed in eval_mm_util");
         }
 
@@ -558,6 +875,7 @@ static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracen
         p = trace->blocks[index];
 
         impl->free(p);
+        trace->blocks[index] = NULL;
 
         /* Keep track of current total size
          * of all allocated blocks */
@@ -565,6 +883,82 @@ static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracen
 
         break;
 
+      case BATCH_ALLOC: /* batch malloc */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->malloc_batch(size, trace->ops[i].count, (void **) &trace->blocks[index]) !=
+            (size_t) trace->ops[i].count) {
+          app_error("malloc_batch failed in eval_mm_util");
+        }
+        for (int id = index; id < index + trace->ops[i].count; id++)
+          trace->block_sizes[id] = size;
+        total_size += size * trace->ops[i].count;
+        max_total_size = (total_size > max_total_size) ?
+            total_size : max_total_size;
+        break;
+
+      case BATCH_FREE: /* batch free */
+        index = trace->ops[i].index;
+        for (int id = index; id < index + trace->ops[i].count; id++)
+          total_size -= trace->block_sizes[id];
+        /* free_batch may overwrite the pointers, but these ids are dead now anyway */
+        impl->free_batch((void **) &trace->blocks[index], trace->ops[i].count);
+        memset(&trace->blocks[index], 0, trace->ops[i].count * sizeof(char *));
+        break;
+
+      case REGION_CREATE: /* create region */
+        if ((trace->regions[trace->ops[i].region] = impl->region_create()) == NULL)
+          app_error("region_create failed in eval_mm_util");
+        break;
+
+      case REGION_ALLOC: /* malloc in a region */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if ((p = (char *) impl->region_malloc(trace->regions[trace->ops[i].region], size)) == NULL)
+          app_error("region_malloc failed in eval_mm_util");
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        total_size += size;
+        max_total_size = (total_size > max_total_size) ?
+            total_size : max_total_size;
+        break;
+
+      case REGION_RESET: /* reset region */
+      case REGION_DESTROY: /* destroy region */
+        if (trace->ops[i].type == REGION_RESET)
+          impl->region_reset(trace->regions[trace->ops[i].region]);
+        else
+          impl->region_destroy(trace->regions[trace->ops[i].region]);
+        total_size -= trace->ops[i].size;
+        break;
+
+      case POOL_CREATE: /* create pool */
+        if ((trace->pools[trace->ops[i].pool] = impl->pool_create(trace->ops[i].size)) == NULL)
+          app_error("pool_create failed in eval_mm_util");
+        break;
+
+      case POOL_ALLOC: /* malloc in a pool */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if ((p = (char *) impl->pool_malloc(trace->pools[trace->ops[i].pool])) == NULL)
+          app_error("pool_malloc failed in eval_mm_util");
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        total_size += size;
+        max_total_size = (total_size > max_total_size) ?
+            total_size : max_total_size;
+        break;
+
+      case POOL_FREE: /* free to a pool */
+        impl->pool_free(trace->pools[trace->ops[i].pool], trace->blocks[trace->ops[i].index]);
+        total_size -= trace->ops[i].size;
+        break;
+
+      case POOL_DESTROY: /* destroy pool */
+        impl->pool_destroy(trace->pools[trace->ops[i].pool]);
+        total_size -= trace->ops[i].size;
+        break;
+
       case WRITE: /* write */
         break;
 
@@ -609,6 +1003,36 @@ static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace) {
         trace->blocks[index] = p;
         break;
 
+      case MEMALIGN: /* memalign */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->memalign == NULL)
+          app_error("impl has no memalign in eval_mm_speed");
+        if ((p = (char *) impl->memalign(trace->ops[i].alignment, size)) == NULL)
+          app_error("memalign error in eval_mm_speed");
+        trace->blocks[index] = p;
+        break;
+
+      case CALLOC: /* calloc */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->calloc == NULL)
+          app_error("impl has no calloc in eval_mm_speed");
+        if ((p = (char *) impl->calloc(1, size)) == NULL)
+          app_error("calloc error in eval_mm_speed");
+        trace->blocks[index] = p;
+        break;
+
+      case ALLOC_HINT: /* malloc with hints */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->malloc_hint == NULL)
+          app_error("impl has no malloc_hint in eval_mm_speed");
+        if ((p = (char *) impl->malloc_hint(size, trace->ops[i].hint)) == NULL)
+          app_error("malloc_hint error in eval_mm_speed");
+        trace->blocks[index] = p;
+        break;
+
       case REALLOC: /* realloc */
         index = trace->ops[i].index;
         newsize = trace->ops[i].size;
@@ -621,7 +1045,72 @@ static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace) {
       case FREE: /* free */
         index = trace->ops[i].index;
         block = trace->blocks[index];
-        impl->free(block);
+        if (free_sized && impl->free_sized != NULL)
+          impl->free_sized(block, trace->ops[i].size);
+        else
+          impl->free(block);
+        break;
+
+      case BATCH_ALLOC: /* batch malloc */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->malloc_batch == NULL)
+          app_error("impl has no malloc_batch in eval_mm_speed");
+        if (impl->malloc_batch(size, trace->ops[i].count, (void **) &trace->blocks[index]) !=
+            (size_t) trace->ops[i].count)
+          app_error("malloc_batch error in eval_mm_speed");
+        break;
+
+      case BATCH_FREE: /* batch free */
+        index = trace->ops[i].index;
+        if (impl->free_batch == NULL)
+          app_error("impl has no free_batch in eval_mm_speed");
+        impl->free_batch((void **) &trace->blocks[index], trace->ops[i].count);
+        break;
+
+      case REGION_CREATE: /* create region */
+        if (impl->region_create == NULL)
+          app_error("impl has no regions in eval_mm_speed");
+        if ((trace->regions[trace->ops[i].region] = impl->region_create()) == NULL)
+          app_error("region_create error in eval_mm_speed");
+        break;
+
+      case REGION_ALLOC: /* malloc in a region */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if ((p = (char *) impl->region_malloc(trace->regions[trace->ops[i].region], size)) == NULL)
+          app_error("region_malloc error in eval_mm_speed");
+        trace->blocks[index] = p;
+        break;
+
+      case REGION_RESET: /* reset region */
+        impl->region_reset(trace->regions[trace->ops[i].region]);
+        break;
+
+      case REGION_DESTROY: /* destroy region */
+        impl->region_destroy(trace->regions[trace->ops[i].region]);
+        break;
+
+      case POOL_CREATE: /* create pool */
+        if (impl->pool_create == NULL)
+          app_error("impl has no pools in eval_mm_speed");
+        if ((trace->pools[trace->ops[i].pool] = impl->pool_create(trace->ops[i].size)) == NULL)
+          app_error("pool_create error in eval_mm_speed");
+        break;
+
+      case POOL_ALLOC: /* malloc in a pool */
+        index = trace->ops[i].index;
+        if ((p = (char *) impl->pool_malloc(trace->pools[trace->ops[i].pool])) == NULL)
+          app_error("pool_malloc error in eval_mm_speed");
+        trace->blocks[index] = p;
+        break;
+
+      case POOL_FREE: /* free to a pool */
+        impl->pool_free(trace->pools[trace->ops[i].pool], trace->blocks[trace->ops[i].index]);
+        break;
+
+      case POOL_DESTROY: /* destroy pool */
+        impl->pool_destroy(trace->pools[trace->ops[i].pool]);
         break;
 
       case WRITE: /* write */
@@ -668,6 +1157,48 @@ static int eval_mm_check(const malloc_impl_t *impl, trace_t *trace, int tracenum
         trace->blocks[index] = p;
         break;
 
+      case MEMALIGN: /* memalign */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->memalign == NULL) {
+          malloc_error(tracenum, i, "impl has no memalign.");
+          return 0;
+        }
+        if ((p = (char *) impl->memalign(trace->ops[i].alignment, size)) == NULL) {
+          malloc_error(tracenum, i, "impl memalign failed.");
+          return 0;
+        }
+        trace->blocks[index] = p;
+        break;
+
+      case CALLOC: /* calloc */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->calloc == NULL) {
+          malloc_error(tracenum, i, "impl has no calloc.");
+          return 0;
+        }
+        if ((p = (char *) impl->calloc(1, size)) == NULL) {
+          malloc_error(tracenum, i, "impl calloc failed.");
+          return 0;
+        }
+        trace->blocks[index] = p;
+        break;
+
+      case ALLOC_HINT: /* malloc with hints */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->malloc_hint == NULL) {
+          malloc_error(tracenum, i, "impl has no malloc_hint.");
+          return 0;
+        }
+        if ((p = (char *) impl->malloc_hint(size, trace->ops[i].hint)) == NULL) {
+          malloc_error(tracenum, i, "impl malloc_hint failed.");
+          return 0;
+        }
+        trace->blocks[index] = p;
+        break;
+
       case REALLOC: /* realloc */
         index = trace->ops[i].index;
         newsize = trace->ops[i].size;
@@ -685,6 +1216,86 @@ static int eval_mm_check(const malloc_impl_t *impl, trace_t *trace, int tracenum
         impl->free(block);
         break;
 
+      case BATCH_ALLOC: /* batch malloc */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if (impl->malloc_batch == NULL) {
+          malloc_error(tracenum, i, "impl has no malloc_batch.");
+          return 0;
+        }
+        if (impl->malloc_batch(size, trace->ops[i].count, (void **) &trace->blocks[index]) !=
+            (size_t) trace->ops[i].count) {
+          malloc_error(tracenum, i, "impl malloc_batch failed.");
+          return 0;
+        }
+        break;
+
+      case BATCH_FREE: /* batch free */
+        index = trace->ops[i].index;
+        if (impl->free_batch == NULL) {
+          malloc_error(tracenum, i, "impl has no free_batch.");
+          return 0;
+        }
+        impl->free_batch((void **) &trace->blocks[index], trace->ops[i].count);
+        break;
+
+      case REGION_CREATE: /* create region */
+        if (impl->region_create == NULL) {
+          malloc_error(tracenum, i, "impl has no regions.");
+          return 0;
+        }
+        if ((trace->regions[trace->ops[i].region] = impl->region_create()) == NULL) {
+          malloc_error(tracenum, i, "impl region_create failed.");
+          return 0;
+        }
+        break;
+
+      case REGION_ALLOC: /* malloc in a region */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if ((p = (char *) impl->region_malloc(trace->regions[trace->ops[i].region], size)) == NULL) {
+          malloc_error(tracenum, i, "impl region_malloc failed.");
+          return 0;
+        }
+        trace->blocks[index] = p;
+        break;
+
+      case REGION_RESET: /* reset region */
+        impl->region_reset(trace->regions[trace->ops[i].region]);
+        break;
+
+      case REGION_DESTROY: /* destroy region */
+        impl->region_destroy(trace->regions[trace->ops[i].region]);
+        break;
+
+      case POOL_CREATE: /* create pool */
+        if (impl->pool_create == NULL) {
+          malloc_error(tracenum, i, "impl has no pools.");
+          return 0;
+        }
+        if ((trace->pools[trace->ops[i].pool] = impl->pool_create(trace->ops[i].size)) == NULL) {
+          malloc_error(tracenum, i, "impl pool_create failed.");
+          return 0;
+        }
+        break;
+
+      case POOL_ALLOC: /* malloc in a pool */
+        index = trace->ops[i].index;
+        if ((p = (char *) impl->pool_malloc(trace->pools[trace->ops[i].pool])) == NULL) {
+          malloc_error(tracenum, i, "impl pool_malloc failed.");
+          return 0;
+        }
+        trace->blocks[index] = p;
+        break;
+
+      case POOL_FREE: /* free to a pool */
+        impl->pool_free(trace->pools[trace->ops[i].pool], trace->blocks[trace->ops[i].index]);
+        break;
+
+      case POOL_DESTROY: /* destroy pool */
+        impl->pool_destroy(trace->pools[trace->ops[i].pool]);
+        break;
+
       case WRITE: /* write */
         break;
 
@@ -712,14 +1323,15 @@ static int eval_mm_check(const malloc_impl_t *impl, trace_t *trace, int tracenum
 static void printresults(int n, char **tracefiles, stats_t *stats) {
   int i;
   double total_ops = 0, total_secs = 0, total_throughput = 0, total_util = 0;
+  double total_sbrks = 0;
 
   /* Print the individual results for each trace */
-  printf("%5s%27s%10s%10s%6s%8s%10s%9s\n",
-         "trace", "filename", " valid", "checked", "util", "ops", "secs", "Kops/sec");
+  printf("%5s%27s%10s%10s%6s%8s%10s%9s%7s\n",
+         "trace", "filename", " valid", "checked", "util", "ops", "secs", "Kops/sec", "sbrks");
   for (i = 0; i < n; i++) {
     if (stats[i].valid) {
       double throughput = (stats[i].ops/stats[i].secs)/1e3;
-      printf("%2d%30s%10s%10s%5.0f%%%8.0f%10.6f %8.0f\n",
+      printf("%2d%30s%10s%10s%5.0f%%%8.0f%10.6f %8.0f%7.0f\n",
              i,
              tracefiles[i],
              "yes",
@@ -727,11 +1339,13 @@ static void printresults(int n, char **tracefiles, stats_t *stats) {
              stats[i].util*100.0,
              stats[i].ops,
              stats[i].secs,
-             throughput);
+             throughput,
+             stats[i].sbrks);
       total_ops += stats[i].ops;
       total_secs += stats[i].secs;
       total_throughput += throughput;
       total_util += stats[i].util;
+      total_sbrks += stats[i].sbrks;
     } else {
       printf("%2d%30s%10s%10s%6s%8s%10s%8s\n",
              i,
@@ -747,13 +1361,14 @@ static void printresults(int n, char **tracefiles, stats_t *stats) {
 
   /* Print the aggregate results for the set of traces */
   if (errors == 0) {
-    printf("%12s%40s%5.0f%%%8.0f%10.6f %8.0f\n",
+    printf("%12s%40s%5.0f%%%8.0f%10.6f %8.0f%7.0f\n",
            "Average     ",
            "",
            (total_util/n)*100.0,
            total_ops,
            total_secs,
-           total_throughput/n);
+           total_throughput/n,
+           total_sbrks/n);
   } else {
     printf("%12s%40s%6s%8s%10s%8s\n",
            "Average     ",
@@ -789,11 +1404,122 @@ void malloc_error(int tracenum, int opnum, char *msg) {
   printf("ERROR [trace %d, line %d]: %s\n", tracenum, LINENUM(opnum), msg);
 }
 
+/*
+ * compare_spans - order [lo, hi) address spans by lo, for qsort
+ */
+static int compare_spans(const void *a, const void *b) {
+  uint64_t lo_a = ((const uint64_t *) a)[0];
+  uint64_t lo_b = ((const uint64_t *) b)[0];
+  return (lo_a > lo_b) - (lo_a < lo_b);
+}
+
+/*
+ * count_units - count the 1 << shift byte units n sorted spans touch, each one once
+ */
+static double count_units(uint64_t (*spans)[2], int n, int shift) {
+  double units = 0;
+  uint64_t end = 0; /* the first unit not counted yet */
+  for (int j = 0; j < n; j++) {
+    uint64_t lo = spans[j][0] >> shift;
+    uint64_t hi = ((spans[j][1] - 1) >> shift) + 1;
+    if (hi > end) {
+      units += hi - ((lo > end) ? lo : end);
+      end = hi;
+    }
+  }
+  return units;
+}
+
+/*
+ * count_covered - count the bytes of [lo, hi) that n sorted spans cover, each one once
+ */
+static double count_covered(uint64_t (*spans)[2], int n, uint64_t lo, uint64_t hi) {
+  double bytes = 0;
+  uint64_t end = lo; /* the first byte not counted yet */
+  for (int j = 0; j < n && spans[j][0] < hi; j++) {
+    uint64_t top = (spans[j][1] < hi) ? spans[j][1] : hi;
+    if (top > end) {
+      bytes += top - ((spans[j][0] > end) ? spans[j][0] : end);
+      end = top;
+    }
+  }
+  return bytes;
+}
+
+/*
+ * sample_placement - add what the live blocks of each hint class touch to placement.
+ *   Blocks in regions and pools are left out, since those aren't hinted, but they
+ *   still fill the holes of a class's span.
+ */
+static void sample_placement(trace_t *trace) {
+  uint64_t (*spans)[2] = malloc(trace->num_ids * sizeof(*spans));
+  uint64_t (*live)[2] = malloc(trace->num_ids * sizeof(*live));
+  if (spans == NULL || live == NULL) {
+    unix_error("malloc failed in sample_placement");
+  }
+  int num_live = 0;
+  for (int id = 0; id < trace->num_ids; id++) {
+    if (trace->blocks[id] == NULL || trace->block_sizes[id] == 0)
+      continue;
+    live[num_live][0] = (uint64_t) trace->blocks[id];
+    live[num_live][1] = live[num_live][0] + trace->block_sizes[id];
+    num_live++;
+  }
+  qsort(live, num_live, sizeof(*live), compare_spans);
+  for (int c = 0; c < MALLOC_HINT_CLASSES; c++) {
+    int n = 0;
+    for (int id = 0; id < trace->num_ids; id++) {
+      if (trace->blocks[id] == NULL || trace->block_sizes[id] == 0 ||
+          trace->block_hints[id] != c || trace->block_regions[id] >= 0 ||
+          trace->block_pools[id] >= 0)
+        continue;
+      spans[n][0] = (uint64_t) trace->blocks[id];
+      spans[n][1] = spans[n][0] + trace->block_sizes[id];
+      placement[c].bytes += trace->block_sizes[id];
+      n++;
+    }
+    qsort(spans, n, sizeof(*spans), compare_spans);
+    placement[c].lines += count_units(spans, n, LINE_SHIFT);
+    placement[c].pages += count_units(spans, n, PAGE_SHIFT);
+    if (n > 0) {
+      uint64_t lo = spans[0][0];
+      uint64_t hi = 0;
+      for (int j = 0; j < n; j++)
+        hi = (spans[j][1] > hi) ? spans[j][1] : hi;
+      placement[c].span += hi - lo;
+      placement[c].holes += hi - lo - count_covered(live, num_live, lo, hi);
+    }
+  }
+  placement_samples++;
+  free(spans);
+  free(live);
+}
+
+/*
+ * printplacement - print how much of the cache lines and pages each hint class
+ *   touched its own bytes filled, and how much of its span was holes, averaged over
+ *   the samples
+ */
+static void printplacement(void) {
+  static const char *names[MALLOC_HINT_CLASSES] = {"unhinted", "short-lived", "long-lived", "cold"};
+  printf("%14s%12s%8s%8s%12s%8s\n", "class", "KB", "lines", "pages", "span KB", "holes");
+  for (int c = 0; c < MALLOC_HINT_CLASSES; c++) {
+    if (placement[c].bytes == 0)
+      continue;
+    printf("%14s%12.0f%7.1f%%%7.1f%%%12.0f%7.1f%%\n", names[c],
+           placement[c].bytes / placement_samples / 1024,
+           100.0 * placement[c].bytes / (placement[c].lines * (1 << LINE_SHIFT)),
+           100.0 * placement[c].bytes / (placement[c].pages * (1 << PAGE_SHIFT)),
+           placement[c].span / placement_samples / 1024,
+           100.0 * placement[c].holes / placement[c].span);
+  }
+}
+
 /*
  * usage - Explain the command line arguments
  */
 static void usage(void) {
-  fprintf(stderr, "Usage: mdriver [-hvVgc] [-f <file>] [-t <dir>]\n");
+  fprintf(stderr, "Usage: mdriver [-hvVgcsazp] [-f <file>] [-t <dir>]\n");
   fprintf(stderr, "Options\n");
   fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
   fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
@@ -801,5 +1527,9 @@ static void usage(void) {
   fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
   fprintf(stderr, "\t-V         Print additional debug info.\n");
   fprintf(stderr, "\t-c         Check the heap after every operation.\n");
+  fprintf(stderr, "\t-s         Print allocator statistics for each trace.\n");
+  fprintf(stderr, "\t-a         Also run the allocator built for 16 byte alignment.\n");
+  fprintf(stderr, "\t-z         Also check and time frees that pass the block's size.\n");
+  fprintf(stderr, "\t-p         Report how densely each hint class's blocks are placed.\n");
   fprintf(stderr, "\t-h         Print this message.\n");
 }
@@ -46,8 +46,12 @@
 #define MAXLINE     1024 /* max string size */
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+#define MAXREGIONS    64 /* max number of regions a trace can use */
+#define MAXPOOLS      64 /* max number of pools a trace can use */
 
-typedef enum {ALLOC, FREE, REALLOC, WRITE} traceop_type; /* type of request */
+typedef enum {ALLOC, FREE, REALLOC, WRITE, MEMALIGN, CALLOC, BATCH_ALLOC, BATCH_FREE,
+              REGION_CREATE, REGION_ALLOC, REGION_RESET, REGION_DESTROY,
+              POOL_CREATE, POOL_ALLOC, POOL_FREE, POOL_DESTROY, ALLOC_HINT} traceop_type; /* type of request */
 /******************************
  * The key compound data types
  *****************************/
@@ -56,7 +60,12 @@ typedef enum {ALLOC, FREE, REALLOC, WRITE} traceop_type; /* type of request */
 typedef struct {
   traceop_type  type; /* type of request */
   int index;                        /* index for free() to use later */
-  int size;                         /* byte size of alloc/realloc request */
+  int size;                         /* byte size of alloc/realloc request, or of the freed block */
+  int alignment;                    /* alignment of memalign request */
+  int count;                        /* number of ids from index on in a batch request */
+  int region;                       /* region of a region request */
+  int pool;                         /* pool of a pool request */
+  int hint;                         /* MALLOC_HINT_ flags of a hinted malloc */
 } traceop_t;
 
 /* Holds the information for one trace file*/
@@ -68,12 +77,19 @@ typedef struct {
   traceop_t *ops;      /* array of requests */
   char **blocks;       /* array of ptrs returned by malloc/realloc... */
   size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+  int *block_regions;  /* region each id is malloc'd in, or -1 */
+  region_t *regions[MAXREGIONS]; /* regions made by region_create */
+  int *block_pools;    /* pool each id is malloc'd in, or -1 */
+  pool_t *pools[MAXPOOLS]; /* pools made by pool_create */
+  int *block_hints;    /* hint class of each id, 0 if it isn't malloc'd with hints */
 } trace_t;
 
 /*********************
  * Function prototypes
  *********************/
 
+extern int free_sized;  /* free with the block's size, impl->free_sized (set by -z) */
+
 void malloc_error(int tracenum, int opnum, char *msg);
 void unix_error(char *msg);
 void app_error(char *msg);
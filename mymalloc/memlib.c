@@ -40,19 +40,22 @@
 static char *mem_start_brk;  /* points to first byte of heap */
 static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */
+static size_t mem_sbrk_calls; /* calls to mem_sbrk since the last reset */
+static char *mem_dirty_brk;  /* highest brk before the last reset; the heap above it is zero */
 
 /*
  * mem_init - initialize the memory system model
  */
 void mem_init(void) {
-  /* allocate the storage we will use to model the available VM */
-  if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
+  /* allocate the storage we will use to model the available VM, zeroed like fresh pages */
+  if ((mem_start_brk = (char *)calloc(1, MAX_HEAP)) == NULL) {
     fprintf(stderr, "mem_init_vm: malloc error\n");
     exit(1);
   }
 
   mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
   mem_brk = mem_start_brk;                  /* heap is empty initially */
+  mem_dirty_brk = mem_start_brk;
 }
 
 /*
@@ -66,7 +69,10 @@ void mem_deinit(void) {
  * mem_reset_brk - reset the simulated brk pointer to make an empty heap
  */
 void mem_reset_brk(void) {
+  if (mem_brk > mem_dirty_brk)
+    mem_dirty_brk = mem_brk;
   mem_brk = mem_start_brk;
+  mem_sbrk_calls = 0;
 }
 
 /*
@@ -76,6 +82,7 @@ void mem_reset_brk(void) {
  */
 void *mem_sbrk(int incr) {
   char *old_brk = __sync_fetch_and_add(&mem_brk, incr);
+  __sync_fetch_and_add(&mem_sbrk_calls, 1);
 
   if ((incr < 0) || (mem_brk > mem_max_addr)) {
     errno = ENOMEM;
@@ -101,6 +108,15 @@ void *mem_heap_lo(void) {
   return (void *)mem_start_brk;
 }
 
+/*
+ * mem_clean_lo - return the address from which no heap before the last
+ *    reset reached, so that the memory there is zero until the current heap
+ *    writes to it, like fresh memory from a real sbrk.
+ */
+void *mem_clean_lo(void) {
+  return (void *)mem_dirty_brk;
+}
+
 /*
  * mem_heap_hi - returns the address of the first byte past the end of the
  *    heap.
@@ -109,6 +125,14 @@ void *mem_heap_hi(void) {
   return (void *)(mem_brk - 1);
 }
 
+/*
+ * mem_sbrk_count() - returns the number of mem_sbrk calls since the heap
+ *    was last reset
+ */
+size_t mem_sbrk_count(void) {
+  return mem_sbrk_calls;
+}
+
 /*
  * mem_heapsize() - returns the heap size in bytes
  */
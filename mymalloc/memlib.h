@@ -31,7 +31,9 @@ void *mem_sbrk(int incr);
 void mem_reset_brk(void);
 void *mem_heap_lo(void);
 void *mem_heap_hi(void);
+void *mem_clean_lo(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
+size_t mem_sbrk_count(void);
 
 #endif  // MM_MEMLIB_H
@@ -4,24 +4,60 @@
 
 bool is_circularly_linked_list(chunk_t* chunk) {
   // If they aren't circularly linked, this will segfault.
-  chunk_t* other = chunk->next;
+  chunk_t* other = NEXT_FREE_CHUNK(chunk);
   int left = 0;
   while (other != chunk) {
     left++;
-    other = other->next;
+    other = NEXT_FREE_CHUNK(other);
   }
   int right = 0;
-  other = chunk->prev;
+  other = PREV_FREE_CHUNK(chunk);
   while (other != chunk) {
+    right++;
+    other = PREV_FREE_CHUNK(other);
+  }
+  return left == right;
+}
+
+bool is_circularly_linked_node_list(bigchunk_t* node) {
+  bigchunk_t* other = node->next;
+  int left = 0;
+  while (other != node) {
+    left++;
+    other = other->next;
+  }
+  int right = 0;
+  other = node->prev;
+  while (other != node) {
     right++;
     other = other->prev;
   }
   return left == right;
 }
 
+bool is_valid_slab_run(slab_t* run, int i) {
+  if (run->bin_number != i || run->object_size != (i << 3))
+    return false;
+  if (run->capacity != SLAB_RUN_CAPACITY(run->object_size))
+    return false;
+  if (run->free_count == 0 || run->free_count > run->capacity)
+    return false;
+  uint32_t free_slots = 0;
+  for (int w = 0; w < SLAB_MAP_WORDS; w++)
+    free_slots += __builtin_popcountll(run->free_map[w]);
+  if (free_slots != run->free_count)
+    return false;
+  // No bits past the last slot
+  for (uint32_t slot = run->capacity; slot < 64 * SLAB_MAP_WORDS; slot++)
+    if ((run->free_map[slot >> 6] >> (slot & 63)) & 1)
+      return false;
+  // The run's chunk must be in use and cover the whole run.
+  chunk_t* chunk = USER_POINTER_TO_CHUNK(run);
+  return IS_CURRENT_INUSE(chunk) && CHUNK_SIZE(chunk) >= SLAB_RUN_CHUNK_SIZE;
+}
+
 bool is_valid_chunk_pointer(chunk_t* chunk) {
-  uint64_t offset = (uint64_t) mem_heap_lo() & 7;
-  chunk_t* start = mem_heap_lo() + offset;
+  chunk_t* start = FIRST_HEAP_CHUNK(mem_heap_lo());
   while (true) {
     if (start == chunk)
       return true;
@@ -60,6 +96,13 @@ bool is_valid_pointer_tree(int i, bigchunk_t* chunk) {
     return false;
   if (chunk->bin_number != i)
     return false;
+  size_int min = NODE_SIZE(chunk);
+  if (SUBTREE_MIN(chunk->children[0]) < min)
+    min = SUBTREE_MIN(chunk->children[0]);
+  if (SUBTREE_MIN(chunk->children[1]) < min)
+    min = SUBTREE_MIN(chunk->children[1]);
+  if (chunk->subtree_min != min)
+    return false;
   if (!is_valid_pointer_tree(i, chunk->children[0]))
     return false;
   if (!is_valid_pointer_tree(i, chunk->children[1]))
@@ -69,27 +112,31 @@ bool is_valid_pointer_tree(int i, bigchunk_t* chunk) {
 
 void print_chunk_summary(chunk_t** bins, chunk_t* chunk) {
   printf("Chunk %p%s:\n", chunk, (IS_END_OF_HEAP(chunk)) ? " (END OF HEAP)" : "");
-  printf("Previous Size: %llu %s\n", chunk->previous_size, (IS_PREVIOUS_INUSE(chunk)) ? " (Can't trust)" : "");
-  printf("Current Size:  %llu\n", CHUNK_SIZE(chunk));
-  printf("PREV_INUSE:    %llu\n", IS_PREVIOUS_INUSE(chunk));
-  printf("CURRENT_INUSE: %llu\n", IS_CURRENT_INUSE(chunk));
-  printf("Next:          %p %s\n", chunk->next, (IS_CURRENT_INUSE(chunk)) ? " (Can't trust)" : "");
-  printf("Prev:          %p %s\n", chunk->prev, (IS_CURRENT_INUSE(chunk)) ? " (Can't trust)" : "");
+  printf("Previous Size: %llu %s\n", (unsigned long long) chunk->previous_size, (IS_PREVIOUS_INUSE(chunk)) ? " (Can't trust)" : "");
+  printf("Current Size:  %llu\n", (unsigned long long) CHUNK_SIZE(chunk));
+  printf("PREV_INUSE:    %llu\n", (unsigned long long) IS_PREVIOUS_INUSE(chunk));
+  printf("CURRENT_INUSE: %llu\n", (unsigned long long) IS_CURRENT_INUSE(chunk));
+  printf("Next:          %p %s\n", NEXT_FREE_CHUNK(chunk), (IS_CURRENT_INUSE(chunk)) ? " (Can't trust)" : "");
+  printf("Prev:          %p %s\n", PREV_FREE_CHUNK(chunk), (IS_CURRENT_INUSE(chunk)) ? " (Can't trust)" : "");
   printf("NEXT_HEAP_CHK: %p\n", NEXT_HEAP_CHUNK(chunk));
   printf("PREV_HEAP_CHK: %p %s\n", PREVIOUS_HEAP_CHUNK(chunk), (IS_PREVIOUS_INUSE(chunk)) ? " (Can't trust)" : "");
   printf("-------\n");
 }
 
-int my_checker(chunk_t** bins, int length) {
+static bool is_victim(chunk_t* chunk, chunk_t** victims, int victim_count) {
+  for (int b = 0; b < victim_count; b++)
+    if (victims[b] == chunk)
+      return true;
+  return false;
+}
+
+int my_checker(chunk_t** bins, int length, chunk_t** victims, int victim_count) {
   static int checks = 0;
   checks++;
-  if (sizeof(chunk_t*)*length > 512)
-    return 1;
 
   // First, do a run-through of the heap
   // If this segfaults, then the IS_END_OF_HEAP macro is incorrect.
-  uint64_t offset = (uint64_t) mem_heap_lo() & 7;
-  chunk_t* chunk = mem_heap_lo() + offset;
+  chunk_t* chunk = FIRST_HEAP_CHUNK(mem_heap_lo());
   while (true) {
     #ifdef VERBOSE
     print_chunk_summary(bins, chunk);
@@ -98,15 +145,24 @@ int my_checker(chunk_t** bins, int length) {
     if (IS_END_OF_HEAP(chunk))
       break;
 
-    if (!IS_VICTIM(chunk) && !IS_CURRENT_INUSE(chunk)) {
-      assert(is_circularly_linked_list(chunk));
-      if (IS_LARGE_CHUNK(chunk) && !IS_HUGE_CHUNK(chunk)) {
-        assert(IS_VALID_LARGE_CHUNK((bigchunk_t*)chunk));
-      } else if (IS_SMALL_CHUNK(chunk)) {
+    if (!is_victim(chunk, victims, victim_count) && !IS_CURRENT_INUSE(chunk)) {
+      if (IS_UNSORTED(chunk)) {
+        assert(IS_LARGE_CHUNK(chunk));
+        assert(is_circularly_linked_list(chunk));
+        assert(is_valid_chunk_pointer(NEXT_FREE_CHUNK(chunk)));
+        assert(is_valid_chunk_pointer(PREV_FREE_CHUNK(chunk)));
+      } else if (IS_LARGE_CHUNK(chunk)) {
+        assert(NODE_SIZE(LARGE_NODE(chunk)) == CHUNK_SIZE(chunk));
+        assert(IS_VALID_LARGE_CHUNK(LARGE_NODE(chunk)));
+        assert(is_circularly_linked_node_list(LARGE_NODE(chunk)));
+        assert(is_valid_chunk_pointer(NODE_CHUNK(LARGE_NODE(chunk)->next)));
+        assert(is_valid_chunk_pointer(NODE_CHUNK(LARGE_NODE(chunk)->prev)));
+      } else {
+        assert(is_circularly_linked_list(chunk));
         assert(IS_VALID_SMALL_CHUNK(chunk));
+        assert(is_valid_chunk_pointer(NEXT_FREE_CHUNK(chunk)));
+        assert(is_valid_chunk_pointer(PREV_FREE_CHUNK(chunk)));
       }
-      assert(is_valid_chunk_pointer(chunk->next));
-      assert(is_valid_chunk_pointer(chunk->prev));
       assert(is_valid_chunk_pointer(chunk));
     }
     if (!IS_CURRENT_INUSE(chunk)) {
@@ -120,7 +176,7 @@ int my_checker(chunk_t** bins, int length) {
     chunk = NEXT_HEAP_CHUNK(chunk);
   }
   assert(IS_PREVIOUS_INUSE(chunk));
-  for (int i = 32; i < 64; i++)
+  for (int i = 32; i < length; i++)
     assert(is_valid_pointer_tree(i, (bigchunk_t*) bins[i]));
   return 0;
 }
@@ -6,8 +6,10 @@
 #ifndef _MY_CHECKER_H
 #define _MY_CHECKER_H
 
-int my_checker(chunk_t** bins, int length);
+int my_checker(chunk_t** bins, int length, chunk_t** victims, int victim_count);
+bool is_circularly_linked_list(chunk_t* chunk);
 bool is_valid_pointer_tree(int i, bigchunk_t* chunk);
+bool is_valid_slab_run(slab_t* run, int i);
 bool chunk_not_in_tree(bigchunk_t* root, bigchunk_t* chunk);
 bool chunk_in_tree(bigchunk_t* root, bigchunk_t* chunk);
 
@@ -0,0 +1,82 @@
+// A typed wrapper around the object pools in allocator.c, for C++ programs linked with
+// the allocator. MyPool<T> hands out storage for one T at a time from a pool of
+// sizeof(T) objects:
+//
+//   MyPool<Node> nodes;
+//   Node* node = nodes.create(key, value);
+//   ...
+//   nodes.destroy(node);
+//
+// Destroying the MyPool frees every object still in it without running destructors, so
+// T should either be trivially destructible or have all its objects destroyed first.
+
+#ifndef MY_POOL_HPP
+#define MY_POOL_HPP
+
+#include <stddef.h>
+#include <new>
+#include <utility>
+
+// Only the pool calls, since allocator_interface.h also defines every package's
+// malloc_impl_t, which would need all of them linked in.
+extern "C" {
+typedef struct pool pool_t;
+pool_t * my_pool_create(size_t object_size);
+void * my_pool_malloc(pool_t *pool);
+void my_pool_free(pool_t *pool, void *ptr);
+void my_pool_destroy(pool_t *pool);
+}
+
+template <typename T>
+class MyPool {
+ public:
+  // Pool objects are only as aligned as any other malloc'd block.
+  static_assert(alignof(T) <= 8, "MyPool objects are only 8 byte aligned");
+
+  MyPool() : pool_(my_pool_create(sizeof(T))) {
+    if (pool_ == NULL)
+      throw std::bad_alloc();
+  }
+
+  ~MyPool() {
+    my_pool_destroy(pool_);
+  }
+
+  MyPool(const MyPool&) = delete;
+  MyPool& operator=(const MyPool&) = delete;
+
+  // Storage for one T, not constructed.
+  T* allocate() {
+    void* object = my_pool_malloc(pool_);
+    if (object == NULL)
+      throw std::bad_alloc();
+    return static_cast<T*>(object);
+  }
+
+  void deallocate(T* object) {
+    my_pool_free(pool_, object);
+  }
+
+  template <typename... Args>
+  T* create(Args&&... args) {
+    T* object = allocate();
+    try {
+      return new (object) T(std::forward<Args>(args)...);
+    } catch (...) {
+      deallocate(object);
+      throw;
+    }
+  }
+
+  void destroy(T* object) {
+    if (object == NULL)
+      return;
+    object->~T();
+    deallocate(object);
+  }
+
+ private:
+  pool_t* pool_;
+};
+
+#endif  // MY_POOL_HPP
@@ -0,0 +1,67 @@
+// Builds my_pool.hpp with the C++ warnings on and runs MyPool through an allocate/free
+// round trip on the simulated heap. Run with make check.
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "./my_pool.hpp"
+
+extern "C" {
+#include "./memlib.h"
+int my_init();
+int my_check();
+void * my_heap_lo();
+void * my_heap_hi();
+}
+
+struct Node {
+  long key;
+  Node* next;
+  Node(long key, Node* next) : key(key), next(next) {}
+};
+
+static const int kNodes = 1000;
+
+static bool in_heap(void* ptr) {
+  return ptr >= my_heap_lo() && ptr <= my_heap_hi();
+}
+
+int main() {
+  mem_init();
+  if (my_init() < 0) {
+    fprintf(stderr, "my_init failed\n");
+    return 1;
+  }
+
+  Node* nodes[kNodes];
+  {
+    MyPool<Node> pool;
+    Node* list = NULL;
+    for (int i = 0; i < kNodes; i++) {
+      list = nodes[i] = pool.create(i, list);
+      assert(in_heap(nodes[i]));
+      assert(((size_t) nodes[i]) % alignof(Node) == 0);
+    }
+    for (int i = kNodes - 1; i >= 0; i--, list = list->next)
+      assert(list == nodes[i] && list->key == i);
+
+    // Free every other node, then take as many again: the pool reuses its own slots.
+    for (int i = 0; i < kNodes; i += 2)
+      pool.destroy(nodes[i]);
+    for (int i = 0; i < kNodes; i += 2) {
+      nodes[i] = pool.create(-i, (Node*) NULL);
+      assert(in_heap(nodes[i]));
+    }
+    for (int i = 0; i < kNodes; i++)
+      assert(nodes[i]->key == (i % 2 == 0 ? -i : i));
+
+    pool.destroy(NULL);
+    assert(my_check() == 0);
+  }
+  // The pool's destructor freed whatever was left in it.
+  assert(my_check() == 0);
+
+  printf("pool_test OK\n");
+  mem_deinit();
+  return 0;
+}
@@ -0,0 +1,57 @@
+// Generated by gen_size_classes.py from traces additional_traces
+// Don't edit this by hand, rerun the generator (make size_classes) instead.
+#ifndef _SIZE_CLASSES_H
+#define _SIZE_CLASSES_H
+
+#include <stdint.h>
+
+// Each doubling of the large sizes is split into up to 2^SIZE_CLASS_BITS bins:
+// 2^8 - 2^10 bytes: 2 per doubling (bins 32 - 35)
+// 2^10 - 2^12 bytes: 4 per doubling (bins 36 - 43)
+// 2^12 - 2^13 bytes: 8 per doubling (bins 44 - 51)
+// 2^13 - 2^14 bytes: 4 per doubling (bins 52 - 55)
+// 2^14 - 2^16 bytes: 8 per doubling (bins 56 - 71)
+// 2^16 - 2^17 bytes: 4 per doubling (bins 72 - 75)
+// 2^17 - 2^20 bytes: 8 per doubling (bins 76 - 99)
+// 2^20 - 2^47 bytes: 1 per doubling (bins 100 - 126)
+#define SIZE_CLASS_BITS 3
+#define FIRST_LARGE_LOG2 8
+#define NUM_OF_LARGE_BINS 95
+
+// The bin of a large bin key with log2 l, indexed by l - FIRST_LARGE_LOG2 and then the
+// SIZE_CLASS_BITS bits below the leading one.
+static const uint8_t large_bin_table[312] = {
+  32, 32, 32, 32, 33, 33, 33, 33, 34, 34, 34, 34, 35, 35, 35, 35,
+  36, 36, 37, 37, 38, 38, 39, 39, 40, 40, 41, 41, 42, 42, 43, 43,
+  44, 45, 46, 47, 48, 49, 50, 51, 52, 52, 53, 53, 54, 54, 55, 55,
+  56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71,
+  72, 72, 73, 73, 74, 74, 75, 75, 76, 77, 78, 79, 80, 81, 82, 83,
+  84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99,
+  100, 100, 100, 100, 100, 100, 100, 100, 101, 101, 101, 101, 101, 101, 101, 101,
+  102, 102, 102, 102, 102, 102, 102, 102, 103, 103, 103, 103, 103, 103, 103, 103,
+  104, 104, 104, 104, 104, 104, 104, 104, 105, 105, 105, 105, 105, 105, 105, 105,
+  106, 106, 106, 106, 106, 106, 106, 106, 107, 107, 107, 107, 107, 107, 107, 107,
+  108, 108, 108, 108, 108, 108, 108, 108, 109, 109, 109, 109, 109, 109, 109, 109,
+  110, 110, 110, 110, 110, 110, 110, 110, 111, 111, 111, 111, 111, 111, 111, 111,
+  112, 112, 112, 112, 112, 112, 112, 112, 113, 113, 113, 113, 113, 113, 113, 113,
+  114, 114, 114, 114, 114, 114, 114, 114, 115, 115, 115, 115, 115, 115, 115, 115,
+  116, 116, 116, 116, 116, 116, 116, 116, 117, 117, 117, 117, 117, 117, 117, 117,
+  118, 118, 118, 118, 118, 118, 118, 118, 119, 119, 119, 119, 119, 119, 119, 119,
+  120, 120, 120, 120, 120, 120, 120, 120, 121, 121, 121, 121, 121, 121, 121, 121,
+  122, 122, 122, 122, 122, 122, 122, 122, 123, 123, 123, 123, 123, 123, 123, 123,
+  124, 124, 124, 124, 124, 124, 124, 124, 125, 125, 125, 125, 125, 125, 125, 125,
+  126, 126, 126, 126, 126, 126, 126, 126,
+};
+
+// The shift of the root of each large bin's trie, by bin - 32: the highest bit that can
+// differ between two sizes in the same bin.
+static const uint8_t large_bin_shift[NUM_OF_LARGE_BINS] = {
+  6, 6, 7, 7, 7, 7, 7, 7, 8, 8, 8, 8, 8, 8, 8, 8,
+  8, 8, 8, 8, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10,
+  11, 11, 11, 11, 11, 11, 11, 11, 13, 13, 13, 13, 13, 13, 13, 13,
+  13, 13, 13, 13, 14, 14, 14, 14, 14, 14, 14, 14, 15, 15, 15, 15,
+  15, 15, 15, 15, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30,
+  31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45,
+};
+
+#endif  // _SIZE_CLASSES_H
@@ -63,10 +63,23 @@ static int add_range(const malloc_impl_t *impl, range_t **ranges, char *lo,
 
   assert(size > 0);
 
-  // Payload addresses must be R_ALIGNMENT-byte aligned
+  // Packages that report usable sizes own every byte up to them, so the slack past the
+  // request must not overlap other blocks or leave the heap either.
+  if (impl->usable_size != NULL) {
+    size_t usable = impl->usable_size(lo);
+    assert(usable >= (size_t) size);
+    if (usable < (size_t) size)
+      return 0;
+    hi = lo + usable - 1;
+  }
+
+  // Payload addresses must be R_ALIGNMENT-byte aligned, or more if the package says so
   assert(IS_ALIGNED(lo));
   if (!IS_ALIGNED(lo))
     return 0;
+  assert(impl->alignment <= R_ALIGNMENT || ((uint64_t) lo) % impl->alignment == 0);
+  if (impl->alignment > R_ALIGNMENT && ((uint64_t) lo) % impl->alignment != 0)
+    return 0;
 
   // The payload must lie within the extent of the heap
   assert(hi <= (char*)mem_heap_hi());
@@ -91,6 +104,58 @@ static int add_range(const malloc_impl_t *impl, range_t **ranges, char *lo,
   return 1;
 }
 
+// fill_slack - Scribble over the usable bytes of the block at p past the words the
+// validator filled, so that anything the package kept there gets caught by its heap
+// checker or by a later operation.
+static void fill_slack(const malloc_impl_t *impl, char *p, int size) {
+  if (impl->usable_size == NULL)
+    return;
+  size_t filled = (size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+  size_t usable = impl->usable_size(p);
+  if (usable > filled)
+    memset(p + filled, 0x5A, usable - filled);
+}
+
+// check_good_size - A malloc of size bytes must be able to hold at least good_size(size)
+// bytes, or callers that ask for good_size up front would write past their blocks.
+static int check_good_size(const malloc_impl_t *impl, char *p, int size) {
+  if (impl->good_size == NULL || impl->usable_size == NULL)
+    return 1;
+  assert(impl->good_size(size) <= impl->usable_size(p));
+  return impl->good_size(size) <= impl->usable_size(p);
+}
+
+// eval_good_size - Run check_good_size on a malloc of every size up to GOOD_SIZE_MAX,
+// both while its size class is new and after the class has had many blocks live at once.
+#define GOOD_SIZE_MAX 1024
+#define GOOD_SIZE_BLOCKS 40
+int eval_good_size(const malloc_impl_t *impl) {
+  char *blocks[GOOD_SIZE_BLOCKS];
+  if (impl->good_size == NULL || impl->usable_size == NULL)
+    return 1;
+  impl->reset_brk();
+  if (impl->init() < 0) {
+    printf("ERROR [good_size]: impl init failed.\n");
+    return 0;
+  }
+  for (int size = 1; size <= GOOD_SIZE_MAX; size++) {
+    for (int b = 0; b < GOOD_SIZE_BLOCKS; b++) {
+      if ((blocks[b] = (char *) impl->malloc(size)) == NULL) {
+        printf("ERROR [good_size]: impl malloc of %d bytes failed.\n", size);
+        return 0;
+      }
+      if (!check_good_size(impl, blocks[b], size)) {
+        printf("ERROR [good_size]: good_size(%d) is %zu, but malloc #%d of it got %zu usable bytes.\n",
+               size, impl->good_size(size), b + 1, impl->usable_size(blocks[b]));
+        return 0;
+      }
+    }
+    for (int b = 0; b < GOOD_SIZE_BLOCKS; b++)
+      impl->free(blocks[b]);
+  }
+  return 1;
+}
+
 // remove_range - Free the range record of block whose payload starts at lo
 static void remove_range(range_t **ranges, char *lo) {
   range_t *p;
@@ -126,6 +191,15 @@ static void clear_ranges(range_t **ranges) {
   *ranges = NULL;
 }
 
+// holds_pattern - whether a block still holds the data eval_mm_valid filled it with
+static int holds_pattern(char *p, size_t size) {
+  for (size_t *writer = (size_t*)p; writer < (size_t*)((char*)p + size); writer++) {
+    if (*writer != ((size_t)((char*)writer - p) ^ (size_t) p))
+      return 0;
+  }
+  return 1;
+}
+
 // eval_mm_valid - Check the malloc package for correctness
 int eval_mm_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
   int i = 0;
@@ -140,6 +214,11 @@ int eval_mm_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
   // Reset the heap.
   impl->reset_brk();
 
+  // No block in a region or pool is live yet
+  for (i = 0; i < trace->num_ids; i++)
+    if (trace->block_regions[i] >= 0 || trace->block_pools[i] >= 0)
+      trace->blocks[i] = NULL;
+
   // Call the mm package's init function
   if (impl->init() < 0) {
     malloc_error(tracenum, 0, "impl init failed.");
@@ -165,18 +244,104 @@ int eval_mm_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
         // and must not overlap any currently allocated block.
         if (add_range(impl, &ranges, p, size, tracenum, i) == 0)
           return 0;
+        if (!check_good_size(impl, p, size)) {
+          malloc_error(tracenum, i, "impl good_size is more than the block's usable size.");
+          return 0;
+        }
 
         // Fill the allocated region with some unique data that you can check
         // for if the region is copied via realloc.
         for (size_t *writer = (size_t*)p; writer < (size_t*)((char*)p + size); writer++) {
           *writer = (size_t)((char*)writer - p) ^ (size_t) p;
         }
+        fill_slack(impl, p, size);
 
         // Remember region
         trace->blocks[index] = p;
         trace->block_sizes[index] = size;
         break;
 
+      case ALLOC_HINT:  // malloc with hints
+
+        // Call the student's malloc_hint, which packages don't have to provide, and
+        // check and fill the block like a malloc'd one
+        if (impl->malloc_hint == NULL) {
+          malloc_error(tracenum, i, "impl has no malloc_hint.");
+          return 0;
+        }
+        if ((p = (char *) impl->malloc_hint(size, trace->ops[i].hint)) == NULL) {
+          malloc_error(tracenum, i, "impl malloc_hint failed.");
+          return 0;
+        }
+        if (add_range(impl, &ranges, p, size, tracenum, i) == 0)
+          return 0;
+        for (size_t *writer = (size_t*)p; writer < (size_t*)((char*)p + size); writer++) {
+          *writer = (size_t)((char*)writer - p) ^ (size_t) p;
+        }
+        fill_slack(impl, p, size);
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        break;
+
+      case MEMALIGN:  // memalign
+
+        // Call the student's memalign, which packages don't have to provide
+        if (impl->memalign == NULL) {
+          malloc_error(tracenum, i, "impl has no memalign.");
+          return 0;
+        }
+        if ((p = (char *) impl->memalign(trace->ops[i].alignment, size)) == NULL) {
+          malloc_error(tracenum, i, "impl memalign failed.");
+          return 0;
+        }
+
+        // On top of the usual checks, the block must have the requested alignment
+        assert(((uint64_t) p) % trace->ops[i].alignment == 0);
+        if (((uint64_t) p) % trace->ops[i].alignment != 0)
+          return 0;
+        if (add_range(impl, &ranges, p, size, tracenum, i) == 0)
+          return 0;
+
+        for (size_t *writer = (size_t*)p; writer < (size_t*)((char*)p + size); writer++) {
+          *writer = (size_t)((char*)writer - p) ^ (size_t) p;
+        }
+        fill_slack(impl, p, size);
+
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        break;
+
+      case CALLOC:  // calloc
+
+        // Call the student's calloc, which packages don't have to provide
+        if (impl->calloc == NULL) {
+          malloc_error(tracenum, i, "impl has no calloc.");
+          return 0;
+        }
+        if ((p = (char *) impl->calloc(1, size)) == NULL) {
+          malloc_error(tracenum, i, "impl calloc failed.");
+          return 0;
+        }
+        if (add_range(impl, &ranges, p, size, tracenum, i) == 0)
+          return 0;
+
+        // The whole block must be zero, and then gets filled like a malloc'd one so
+        // that later callocs of the same memory find it dirty.
+        for (size_t j = 0; j < size; j++) {
+          if (p[j] != 0) {
+            malloc_error(tracenum, i, "calloc'd block is not zero.");
+            return 0;
+          }
+        }
+        for (size_t *writer = (size_t*)p; writer < (size_t*)((char*)p + size); writer++) {
+          *writer = (size_t)((char*)writer - p) ^ (size_t) p;
+        }
+        fill_slack(impl, p, size);
+
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        break;
+
       case REALLOC:  // realloc
 
         // Call the student's realloc
@@ -209,6 +374,7 @@ int eval_mm_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
         for (size_t *writer = (size_t*)newp; writer < (size_t*)((char*)newp + size); writer++) {
           *writer = (size_t)((char*)writer - newp) ^ (size_t) newp;
         }
+        fill_slack(impl, newp, size);
 
         // Remember region
         trace->blocks[index] = newp;
@@ -220,7 +386,158 @@ int eval_mm_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
         // Remove region from list and call student's free function
         p = trace->blocks[index];
         remove_range(&ranges, p);
-        impl->free(p);
+        if (free_sized && impl->free_sized != NULL)
+          impl->free_sized(p, trace->block_sizes[index]);
+        else
+          impl->free(p);
+        break;
+
+      case BATCH_ALLOC:  // batch malloc
+
+        // Call the student's malloc_batch, which packages don't have to provide, and
+        // check and fill every block it returns like a malloc'd one
+        if (impl->malloc_batch == NULL) {
+          malloc_error(tracenum, i, "impl has no malloc_batch.");
+          return 0;
+        }
+        if (impl->malloc_batch(size, trace->ops[i].count, (void **) &trace->blocks[index]) !=
+            (size_t) trace->ops[i].count) {
+          malloc_error(tracenum, i, "impl malloc_batch failed.");
+          return 0;
+        }
+        for (int id = index; id < index + trace->ops[i].count; id++) {
+          p = trace->blocks[id];
+          if (add_range(impl, &ranges, p, size, tracenum, i) == 0)
+            return 0;
+          for (size_t *writer = (size_t*)p; writer < (size_t*)((char*)p + size); writer++) {
+            *writer = (size_t)((char*)writer - p) ^ (size_t) p;
+          }
+          fill_slack(impl, p, size);
+          trace->block_sizes[id] = size;
+        }
+        break;
+
+      case BATCH_FREE:  // batch free
+
+        if (impl->free_batch == NULL) {
+          malloc_error(tracenum, i, "impl has no free_batch.");
+          return 0;
+        }
+        for (int id = index; id < index + trace->ops[i].count; id++)
+          remove_range(&ranges, trace->blocks[id]);
+        impl->free_batch((void **) &trace->blocks[index], trace->ops[i].count);
+        break;
+
+      case REGION_CREATE:  // create region
+
+        // Regions are optional, so a package has all four calls or none
+        if (impl->region_create == NULL) {
+          malloc_error(tracenum, i, "impl has no regions.");
+          return 0;
+        }
+        if ((trace->regions[trace->ops[i].region] = impl->region_create()) == NULL) {
+          malloc_error(tracenum, i, "impl region_create failed.");
+          return 0;
+        }
+        break;
+
+      case REGION_ALLOC:  // malloc in a region
+
+        if ((p = (char *) impl->region_malloc(trace->regions[trace->ops[i].region], size)) == NULL) {
+          malloc_error(tracenum, i, "impl region_malloc failed.");
+          return 0;
+        }
+        // Objects in a region have no usable size of their own, so they only own what was
+        // asked for.
+        malloc_impl_t exact = *impl;
+        exact.usable_size = NULL;
+        if (add_range(&exact, &ranges, p, size, tracenum, i) == 0)
+          return 0;
+        for (size_t *writer = (size_t*)p; writer < (size_t*)((char*)p + size); writer++) {
+          *writer = (size_t)((char*)writer - p) ^ (size_t) p;
+        }
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        break;
+
+      case REGION_RESET:  // reset region
+      case REGION_DESTROY:  // destroy region
+
+        // Every object in the region must still hold its data until now
+        for (int id = 0; id < trace->num_ids; id++) {
+          if (trace->block_regions[id] != trace->ops[i].region || trace->blocks[id] == NULL)
+            continue;
+          p = trace->blocks[id];
+          if (!holds_pattern(p, trace->block_sizes[id])) {
+            malloc_error(tracenum, i, "region object was overwritten.");
+            return 0;
+          }
+          remove_range(&ranges, p);
+          trace->blocks[id] = NULL;
+        }
+        if (trace->ops[i].type == REGION_RESET)
+          impl->region_reset(trace->regions[trace->ops[i].region]);
+        else
+          impl->region_destroy(trace->regions[trace->ops[i].region]);
+        break;
+
+      case POOL_CREATE:  // create pool
+
+        if (impl->pool_create == NULL) {
+          malloc_error(tracenum, i, "impl has no pools.");
+          return 0;
+        }
+        if ((trace->pools[trace->ops[i].pool] = impl->pool_create(size)) == NULL) {
+          malloc_error(tracenum, i, "impl pool_create failed.");
+          return 0;
+        }
+        break;
+
+      case POOL_ALLOC:  // malloc in a pool
+
+        if ((p = (char *) impl->pool_malloc(trace->pools[trace->ops[i].pool])) == NULL) {
+          malloc_error(tracenum, i, "impl pool_malloc failed.");
+          return 0;
+        }
+        // Like region objects, pool objects have no usable size of their own
+        malloc_impl_t exact_pool = *impl;
+        exact_pool.usable_size = NULL;
+        if (add_range(&exact_pool, &ranges, p, size, tracenum, i) == 0)
+          return 0;
+        for (size_t *writer = (size_t*)p; writer < (size_t*)((char*)p + size); writer++) {
+          *writer = (size_t)((char*)writer - p) ^ (size_t) p;
+        }
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        break;
+
+      case POOL_FREE:  // free to a pool
+
+        // Pool objects sit right next to each other with no header between them, so check
+        // that none was written past
+        p = trace->blocks[index];
+        if (!holds_pattern(p, size)) {
+          malloc_error(tracenum, i, "pool object was overwritten.");
+          return 0;
+        }
+        remove_range(&ranges, p);
+        trace->blocks[index] = NULL;
+        impl->pool_free(trace->pools[trace->ops[i].pool], p);
+        break;
+
+      case POOL_DESTROY:  // destroy pool
+
+        for (int id = 0; id < trace->num_ids; id++) {
+          if (trace->block_pools[id] != trace->ops[i].pool || trace->blocks[id] == NULL)
+            continue;
+          if (!holds_pattern(trace->blocks[id], trace->block_sizes[id])) {
+            malloc_error(tracenum, i, "pool object was overwritten.");
+            return 0;
+          }
+          remove_range(&ranges, trace->blocks[id]);
+          trace->blocks[id] = NULL;
+        }
+        impl->pool_destroy(trace->pools[trace->ops[i].pool]);
         break;
 
       case WRITE:  // write